@@ -0,0 +1,286 @@
+"""Microbenchmarks of the pyfri bindings and tools.
+
+    python benchmarks/benchmark.py [--replay session.pkt] [--json results.json]
+
+Every benchmark reports the time per call and the bytes a single call
+allocates on the Python heap (traced by tracemalloc, which includes NumPy
+buffers). The LBRState getters, LBRCommand setters and step() need a session
+recorded with fri.RecordingConnection, which is replayed through a
+fri.ReplayConnection as fast as possible. Without --replay only the filters,
+kinematics and pseudo-inverse are measured.
+"""
+
+import argparse
+import json
+import sys
+import time
+import timeit
+import tracemalloc
+from functools import partial
+
+import numpy as np
+
+import pyfri as fri
+from pyfri.tools.filters import ExponentialStateFilter, MovingAverageFilter
+from pyfri.tools.state_estimators import (
+    FRIExternalTorqueEstimator,
+    JointStateEstimator,
+    WrenchEstimatorTaskOffset,
+)
+
+N = fri.LBRState.NUMBER_OF_JOINTS
+
+# Getters that need arguments other than an output array
+SKIPPED_GETTERS = {"getBooleanIOValue", "getDigitalIOValue", "getAnalogIOValue"}
+
+
+def measure(function, repeat=5):
+    """Best time per call in ns and bytes allocated by one call."""
+    function()  # warm up, e.g. lazily created caches
+
+    timer = timeit.Timer(function)
+    number, _ = timer.autorange()
+    ns = min(timer.repeat(repeat, number)) / number * 1e9
+
+    tracemalloc.start()
+    allocations = []
+    for _ in range(repeat):
+        tracemalloc.reset_peak()
+        current, _ = tracemalloc.get_traced_memory()
+        function()
+        _, peak = tracemalloc.get_traced_memory()
+        allocations.append(peak - current)
+    tracemalloc.stop()
+    return ns, min(allocations)
+
+
+class Results:
+    def __init__(self):
+        self.rows = []
+
+    def add(self, group, name, function):
+        self.record(group, name, *measure(function))
+
+    def record(self, group, name, ns, allocated):
+        self.rows.append(
+            {"group": group, "name": name, "ns": ns, "allocated": allocated}
+        )
+        print(f"{group:<12} {name:<48} {ns:>10.1f} ns {allocated:>8d} B")
+
+
+class BenchmarkClient(fri.LBRClient):
+    """Holds the current position, as the KUKA default client does."""
+
+    def __init__(self):
+        super().__init__()
+        self.q = np.zeros(N)
+
+    def monitor(self):
+        pass
+
+    def onStateChange(self, old_state, new_state):
+        pass
+
+    def waitForCommand(self):
+        self.robotState().getIpoJointPosition(self.q)
+        self.robotCommand().setJointPosition(self.q)
+
+    def command(self):
+        self.robotState().getIpoJointPosition(self.q)
+        self.robotCommand().setJointPosition(self.q)
+
+
+def benchmark_tools(results):
+    rng = np.random.default_rng(0)
+    x = rng.standard_normal(N)
+    out = np.empty(N)
+
+    native_filters = {
+        "ExponentialFilter": fri.ExponentialFilter(),
+        "MovingAverageFilter(10)": fri.MovingAverageFilter(10),
+        "ButterworthFilter(10, 1000)": fri.ButterworthFilter(10.0, 1000.0),
+        "MedianFilter(5)": fri.MedianFilter(5),
+    }
+    for name, native in native_filters.items():
+        results.add("filters", name, partial(native.filter, x))
+        results.add("filters", name + " out", partial(native.filter, x, out))
+
+    python_filters = {
+        "tools.ExponentialStateFilter": ExponentialStateFilter(),
+        "tools.MovingAverageFilter(10)": MovingAverageFilter(10),
+    }
+    for name, python in python_filters.items():
+        results.add("filters", name, partial(python.filter, x))
+
+    kinematics = fri.Kinematics("med7")
+    transforms = np.empty((4, 4))
+    jacobians = np.empty((6, N))
+    batch = rng.standard_normal((100, N))
+    calls = {
+        "forward_kinematics": (kinematics.forward_kinematics, x),
+        "forward_kinematics out": (kinematics.forward_kinematics, x, transforms),
+        "jacobian": (kinematics.jacobian, x),
+        "jacobian out": (kinematics.jacobian, x, jacobians),
+        "jacobian (100, 7)": (kinematics.jacobian, batch),
+    }
+    for name, call in calls.items():
+        results.add("kinematics", name, partial(*call))
+
+    J = kinematics.jacobian(x)
+    Js = kinematics.jacobian(batch)
+    results.add("pinv", "pinv (6, 7)", partial(fri.pinv, J))
+    results.add("pinv", "numpy.linalg.pinv (6, 7)", partial(np.linalg.pinv, J))
+    results.add("pinv", "pinv (100, 6, 7)", partial(fri.pinv, Js))
+    results.add("pinv", "numpy.linalg.pinv (100, 6, 7)", partial(np.linalg.pinv, Js))
+
+
+def benchmark_state(results, client):
+    state = client.robotState()
+    out = np.empty(N)
+    for name in sorted(dir(fri.LBRState)):
+        if not name.startswith("get") or name in SKIPPED_GETTERS:
+            continue
+        method = getattr(state, name)
+        for args, label in (((), name), ((out,), name + "(out)")):
+            try:
+                method(*args)
+            except (TypeError, RuntimeError):
+                continue  # overload does not exist or is not exposed
+            results.add("LBRState", label, partial(method, *args))
+
+    snapshot = np.empty(1, dtype=fri.STATE_SNAPSHOT_DTYPE)
+    results.add("LBRState", "snapshot(out)", partial(state.snapshot, snapshot))
+
+
+def benchmark_command(results, client):
+    command = client.robotCommand()
+    q = client.robotState().getIpoJointPosition(np.empty(N))
+    values = {
+        "float64": q,
+        "float32": q.astype(np.float32),
+        "strided": np.repeat(q, 2)[::2],
+        "list": q.tolist(),
+    }
+    for kind, value in values.items():
+        results.add(
+            "LBRCommand",
+            f"setJointPosition({kind})",
+            partial(command.setJointPosition, value),
+        )
+    results.add("LBRCommand", "setTorque", partial(command.setTorque, np.zeros(N)))
+    results.add("LBRCommand", "setWrench", partial(command.setWrench, np.zeros(6)))
+    results.add(
+        "LBRCommand",
+        "setCommand(position, torque)",
+        partial(command.setCommand, position=q, torque=np.zeros(N)),
+    )
+
+
+def replay(app):
+    """Replay the whole session, returns the number of steps."""
+    app.connect(30200, None)
+    steps = 0
+    while app.step():
+        steps += 1
+    app.disconnect()
+    return steps
+
+
+def benchmark_step(results, file_name):
+    def python_estimators(client):
+        joint_state_estimator = JointStateEstimator(client)
+        external_torque_estimator = FRIExternalTorqueEstimator(client)
+        wrench_estimator = WrenchEstimatorTaskOffset(
+            client,
+            joint_state_estimator,
+            external_torque_estimator,
+            fri.Kinematics("med7"),
+            "lbr_link_ee",
+        )
+        command = client.command
+
+        def command_with_wrench():
+            command()
+            wrench_estimator.update()
+            if wrench_estimator.ready():
+                wrench_estimator.get_wrench()
+
+        client.command = command_with_wrench
+
+    setups = {
+        "BenchmarkClient": lambda client: None,
+        "+ native JointStateEstimator": fri.JointStateEstimator,
+        "+ tools estimators and wrench": python_estimators,
+    }
+    for name, setup in setups.items():
+        client = BenchmarkClient()
+        setup(client)
+        app = fri.ClientApplication(client, fri.ReplayConnection(file_name))
+        steps = replay(app)
+        if steps == 0:
+            raise RuntimeError(f"{file_name} holds no packets")
+        elapsed = min(timeit.repeat(partial(replay, app), number=1, repeat=5))
+
+        # Allocations of one step in the middle of the session
+        app.connect(30200, None)
+        for _ in range(steps // 2):
+            app.step()
+        tracemalloc.start()
+        tracemalloc.reset_peak()
+        current, _ = tracemalloc.get_traced_memory()
+        app.step()
+        _, peak = tracemalloc.get_traced_memory()
+        tracemalloc.stop()
+        app.disconnect()
+
+        results.record("step", name, elapsed / steps * 1e9, peak - current)
+
+
+def args_factory():
+    parser = argparse.ArgumentParser(description="Benchmark pyfri.")
+    parser.add_argument(
+        "--replay",
+        help="packet file recorded with fri.RecordingConnection, enables the "
+        "LBRState, LBRCommand and step() benchmarks",
+    )
+    parser.add_argument("--json", help="write the results to this file")
+    return parser.parse_args()
+
+
+def main():
+    args = args_factory()
+    print("Running FRI Version:", fri.FRI_CLIENT_VERSION)
+    print(f"{'group':<12} {'benchmark':<48} {'time':>13} {'allocated':>10}")
+
+    results = Results()
+    benchmark_tools(results)
+
+    if args.replay:
+        # Step into the session once so that the state holds a message
+        client = BenchmarkClient()
+        app = fri.ClientApplication(client, fri.ReplayConnection(args.replay))
+        app.connect(30200, None)
+        if not app.step():
+            print(f"{args.replay} holds no packets.")
+            return 1
+        benchmark_state(results, client)
+        benchmark_command(results, client)
+        app.disconnect()
+        benchmark_step(results, args.replay)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(
+                {
+                    "fri_version": fri.FRI_CLIENT_VERSION,
+                    "time": time.time(),
+                    "results": results.rows,
+                },
+                f,
+                indent=2,
+            )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
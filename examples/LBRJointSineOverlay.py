@@ -7,6 +7,7 @@ import numpy as np
 import pandas as pd
 
 import pyfri as fri
+from pyfri.tools.recording import load_recording
 
 
 class LBRJointSineOverlayClient(fri.LBRClient):
@@ -120,7 +121,7 @@ def main():
     )
     app = fri.ClientApplication(client)
     if args.save_data:
-        app.collect_data("lbr_joint_sine_overlay.csv")
+        app.collect_data("lbr_joint_sine_overlay.col", fri.RecordingFormat.COLUMNAR)
     success = app.connect(args.port, args.hostname)
 
     if not success:
@@ -140,7 +141,7 @@ def main():
     finally:
         app.disconnect()
         if args.save_data:
-            df = pd.read_csv("lbr_joint_sine_overlay.csv")
+            df = pd.DataFrame(load_recording("lbr_joint_sine_overlay.col"))
 
             fig, ax = plt.subplots(4, 1, sharex=True)
 
@@ -3,12 +3,11 @@ import sys
 
 import numpy as np
 from admittance import AdmittanceController
+from robot import load_robot
 
 import pyfri as fri
-from pyfri.tools.filters import ExponentialStateFilter
 from pyfri.tools.state_estimators import (
     FRIExternalTorqueEstimator,
-    JointStateEstimator,
     WrenchEstimatorTaskOffset,
 )
 
@@ -22,7 +21,7 @@ class HandGuideClient(fri.LBRClient):
     def __init__(self, lbr_ver):
         super().__init__()
         self.controller = AdmittanceController(lbr_ver)
-        self.joint_state_estimator = JointStateEstimator(self)
+        self.joint_state_estimator = fri.JointStateEstimator(self)
         self.external_torque_estimator = FRIExternalTorqueEstimator(self)
         self.wrench_estimator = WrenchEstimatorTaskOffset(
             self,
@@ -31,7 +30,7 @@ class HandGuideClient(fri.LBRClient):
             self.controller.robot,
             self.controller.ee_link,
         )
-        self.wrench_filter = ExponentialStateFilter()
+        self.wrench_filter = fri.ExponentialFilter()
 
     def command_position(self):
         self.robotCommand().setJointPosition(self.q.astype(np.float32))
@@ -95,15 +94,41 @@ def args_factory():
         required=True,
         help="The KUKA LBR Med version number.",
     )
+    parser.add_argument(
+        "--native",
+        dest="native",
+        default=False,
+        action="store_true",
+        help="Run the admittance controller natively inside step().",
+    )
 
     return parser.parse_args()
 
 
+def native_client(lbr_ver):
+    # Same gains, velocity and joint limits as AdmittanceController
+    robot = load_robot(lbr_ver, [1])
+    client = fri.LBRClient()
+    client.set_controller(
+        fri.AdmittanceController(
+            f"med{lbr_ver}",
+            damping=1.0 / np.array([0.05, 0.05, 0.05, 0.3, 0.3, 0.3]),
+            max_velocity=np.concatenate(([0.2, 0.2, 0.2], np.deg2rad([40] * 3))),
+            lower=np.asarray(robot.lower_actuated_joint_limits).flatten(),
+            upper=np.asarray(robot.upper_actuated_joint_limits).flatten(),
+        )
+    )
+    return client
+
+
 def main():
     print("Running FRI Version:", fri.FRI_CLIENT_VERSION)
 
     args = args_factory()
-    client = HandGuideClient(args.lbr_ver)
+    if args.native:
+        client = native_client(args.lbr_ver)
+    else:
+        client = HandGuideClient(args.lbr_ver)
     app = fri.ClientApplication(client)
     success = app.connect(args.port, args.hostname)
 
@@ -12,13 +12,17 @@ Quick Start:
     a command is sent.)
 - Error: INCORRECT_DATA_PACKET_COUNTER
     As you might reset the controller or this script, the data packet counter is
-    not always aligned. You can mannually reset `KUKA_UDP`'s `packet_sent` to 
-    `seq_kuka_recv` which is the third value in the printed state header.
+    not always aligned. `KUKA_UDP` continues from `seq_kuka_recv`, the third value
+    in the printed state header, and repeats the request once.
+- `KUKA_UDP_CELL` talks to several controllers over one non-blocking socket,
+    requests are pipelined and the replies collected with a selector.
 
 TODO:
 - Test With App_Enable supported option.
 """
+import dataclasses
 import enum
+import selectors
 import socket
 import time
 
@@ -43,6 +47,50 @@ class KUKA_INPUT_SIGNAL(enum.Enum):
     GET_STATE = 3
 
 
+@dataclasses.dataclass
+class KUKA_STATE:
+    """Status message of the controller."""
+
+    timestamp: float  # s
+    packet_sent: int  # counter of the controller's messages
+    packet_received: int  # last counter received from the client
+    error_id: int  # KUKA_ERROR_CODE
+    aut_active: bool
+    aut_ready: bool
+    app_error: bool
+    station_error: bool
+    app_state: str
+    app_start: bool
+    app_enable: bool
+
+    @classmethod
+    def parse(cls, data: bytes):
+        fields = data.decode("utf-8").strip().split(";")
+        if len(fields) < 11:
+            raise ValueError(f"Malformed status message: {data!r}")
+        return cls(
+            int(fields[0]) / 1000,
+            int(fields[1]),
+            int(fields[2]),
+            int(fields[3]),
+            *(value == "true" for value in fields[4:8]),
+            fields[8],
+            fields[9] == "true",
+            fields[10] == "true",
+        )
+
+
+def compose_cmd(
+    packet_num: int, input_signal: KUKA_INPUT_SIGNAL, value: bool = True
+) -> str:
+    return "%d;%d;%s;%s" % (
+        time.time() * 1000,
+        packet_num,
+        KUKA_UDP.SIGNAL_NAME_MAP[input_signal],
+        KUKA_UDP.CMD_VALUE_TRUE if value else KUKA_UDP.CMD_VALUE_FALSE,
+    )
+
+
 import threading
 
 class KUKA_UDP:
@@ -109,6 +157,7 @@ class KUKA_UDP:
             self.app_enable_heartbeat_thread = None
 
         self.packet_sent = initial_packet_seq
+        self.state = None # last KUKA_STATE received
 
         self.client_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
         self.client_socket.settimeout(0.1) # 100ms
@@ -152,10 +201,6 @@ class KUKA_UDP:
             self.packet_sent += 1
         return self.packet_sent
     
-    @staticmethod
-    def __get_timestamp() -> str:
-        return str(int(time.time() * 1000))
-    
     def __send(self, msg: str):
         if self.verbose:
             print(f"Sending: {msg}")
@@ -164,12 +209,7 @@ class KUKA_UDP:
     
     def __compose_cmd(self, input_signal: KUKA_INPUT_SIGNAL, 
                       value: bool = True) -> str:
-        return ";".join([
-            self.__get_timestamp(),
-            str(self.__get_packet_num()),
-            self.SIGNAL_NAME_MAP[input_signal],
-            self.CMD_VALUE_TRUE if value else self.CMD_VALUE_FALSE
-        ])
+        return compose_cmd(self.__get_packet_num(), input_signal, value)
     
     def __recv(self) -> bool:
         # In the following cases, the robot controller sends status messages 
@@ -182,57 +222,50 @@ class KUKA_UDP:
             if self.verbose:
                 print("Recv:", data.decode())
 
-            data = data.decode().split(';')
-            # TODO: error catch
-            ts = int(data[0]) / 1000
-            seq_kuka_sent = int(data[1])
-            seq_kuka_recv = int(data[2])
-            error_id = int(data[3])
-            aut_activate = data[4] == 'true'
-            aut_ready = data[5] == 'true'
-            app_error = data[6] == 'true'
-            station_error = data[7] == 'true'
-            app_state = data[8]
-            signal_app_start = data[9] == 'true'
-            signal_app_enable = data[10] == 'true'
-            header = (f"[{ts:.3f}, {seq_kuka_sent}, {seq_kuka_recv}]")
-            if error_id < 0:
-                print(header, f"Error: {KUKA_ERROR_CODE(error_id).name}")
-            if not aut_activate:
+            state = KUKA_STATE.parse(data)
+            self.state = state
+            header = (f"[{state.timestamp:.3f}, {state.packet_sent}, "
+                      f"{state.packet_received}]")
+            if state.error_id < 0:
+                print(header, f"Error: {KUKA_ERROR_CODE(state.error_id).name}")
+            if not state.aut_active:
                 print(header, "AUT mode is not activated!") # switch the key and change the mode
-            if not aut_ready:
+            if not state.aut_ready:
                 print(header, "AUT mode is not ready!") # switch the key back
-            if app_error:
+            if state.app_error:
                 print(header, "APP error occurs!")
                 # TODO return this message and restart the APP
-            if station_error:
+            if state.station_error:
                 print(header, "Station Error!")
-            print(header, "APP State:", app_state)
-            print(header, f"app_start: {signal_app_start}\tapp_enable: {signal_app_enable}")
+            print(header, "APP State:", state.app_state)
+            print(header, f"app_start: {state.app_start}\tapp_enable: {state.app_enable}")
             
+            if (state.error_id ==
+                    KUKA_ERROR_CODE.INCORRECT_DATA_PACKET_COUNTER.value):
+                # Continue from the controller's counter
+                self.packet_sent = max(self.packet_sent, state.packet_received)
+                return False
             return True
         except socket.timeout:
             print('REQUEST TIMED OUT')
             return False
 
+    def __request(self, input_signal: KUKA_INPUT_SIGNAL, value: bool = True):
+        self.__send(self.__compose_cmd(input_signal, value))
+        if (not self.__recv() and self.state is not None and
+                self.state.error_id ==
+                KUKA_ERROR_CODE.INCORRECT_DATA_PACKET_COUNTER.value):
+            self.__send(self.__compose_cmd(input_signal, value))
+            self.__recv()
+
     def get_state(self):
-        self.__send(
-            self.__compose_cmd(
-                KUKA_INPUT_SIGNAL.GET_STATE
-            )
-        )
-        self.__recv()
+        self.__request(KUKA_INPUT_SIGNAL.GET_STATE)
 
     def app_start(self):
         if self.with_app_enable_supported:
             self._app_enable_heartbeat_start()
 
-        self.__send(
-            self.__compose_cmd(
-                KUKA_INPUT_SIGNAL.APP_START
-            )
-        )
-        self.__recv()
+        self.__request(KUKA_INPUT_SIGNAL.APP_START)
     
     def app_stop(self):
         if not self.with_app_enable_supported:
@@ -240,13 +273,7 @@ class KUKA_UDP:
             print("Please use the SmartPAD to stop")
             return
         
-        self.__send(
-            self.__compose_cmd(
-                KUKA_INPUT_SIGNAL.APP_ENABLE,
-                False
-            )
-        )
-        self.__recv()
+        self.__request(KUKA_INPUT_SIGNAL.APP_ENABLE, False)
         self._app_enable_heartbeat_cancel()
     
     def app_enable(self, show_reply = False):
@@ -262,6 +289,244 @@ class KUKA_UDP:
         self.app_stop()
         self.app_start()
 
+
+class KUKA_UDP_CELL:
+    """Non-blocking client for the external control of several controllers.
+
+    All controllers are served by one UDP socket that never blocks. Requests are
+    sent at once and matched to the replies by their packet counter, so polling N
+    controllers takes one round trip instead of N. The counter of every controller
+    continues from the controller's own counter when it reports
+    INCORRECT_DATA_PACKET_COUNTER, and the pending requests are repeated once per
+    realignment, counting towards their retries.
+
+    Without App_Enable support `request`, `collect` and `get_states` are all that is
+    needed. With it `service` must be called at least every HEARTBEAT_PERIOD, e.g.
+    from a selector loop with `fileno`, to keep the enabled applications running.
+    """
+
+    HEARTBEAT_PERIOD = 0.05  # s, the controller pauses after 100 ms
+
+    @dataclasses.dataclass
+    class _Controller:
+        address: tuple
+        packet_sent: int
+        state: KUKA_STATE = None
+        enabled: bool = False
+        # counter: [input_signal, value, time sent, attempts, first counter]
+        pending: dict = dataclasses.field(default_factory=dict)
+        failed: set = dataclasses.field(default_factory=set)  # first counters
+        heartbeat: float = 0.0
+        realigned_from: int = None  # controller counter of the last realignment
+
+    def __init__(
+        self,
+        kuka_ips,
+        initial_packet_seq=0,
+        timeout=0.1,
+        retries=2,
+        verbose=False,
+    ):
+        """
+        @param timeout: s until a request without reply is repeated
+        @param retries: repetitions before a request is given up
+        """
+        self.timeout = timeout
+        self.retries = retries
+        self.verbose = verbose
+        self.controllers = {
+            ip: KUKA_UDP_CELL._Controller(
+                (ip, KUKA_UDP.FIXED_UDP_PORT), initial_packet_seq
+            )
+            for ip in kuka_ips
+        }
+        self._by_address = {
+            controller.address: ip for ip, controller in self.controllers.items()
+        }
+        self._socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self._socket.setblocking(False)
+        self._selector = selectors.DefaultSelector()
+        self._selector.register(self._socket, selectors.EVENT_READ)
+
+    def close(self):
+        self._selector.close()
+        self._socket.close()
+
+    def fileno(self):
+        return self._socket.fileno()
+
+    def state(self, kuka_ip):
+        """Last status message of the controller, None before the first one."""
+        return self.controllers[kuka_ip].state
+
+    def request(self, kuka_ip, input_signal: KUKA_INPUT_SIGNAL, value: bool = True):
+        """Send a request without waiting, returns its packet counter."""
+        controller = self.controllers[kuka_ip]
+        controller.packet_sent += 1
+        counter = controller.packet_sent
+        controller.pending[counter] = [
+            input_signal,
+            value,
+            time.monotonic(),
+            0,
+            counter,
+        ]
+        self._send(controller, counter, input_signal, value)
+        return counter
+
+    def process(self):
+        """Read the received status messages, returns the ips that sent one."""
+        updated = []
+        while True:
+            try:
+                data, address = self._socket.recvfrom(1024)
+            except (BlockingIOError, InterruptedError):
+                return updated
+            except ConnectionRefusedError:
+                continue  # ICMP error of a previous datagram
+            kuka_ip = self._by_address.get(address)
+            if kuka_ip is None:
+                continue
+            if self.verbose:
+                print(f"Recv from {kuka_ip}:", data.decode())
+            try:
+                state = KUKA_STATE.parse(data)
+            except ValueError as error:
+                print(kuka_ip, error)
+                continue
+            self._receive(kuka_ip, self.controllers[kuka_ip], state)
+            updated.append(kuka_ip)
+
+    def service(self):
+        """Repeat timed out requests and send the App_Enable heartbeats."""
+        now = time.monotonic()
+        for kuka_ip, controller in self.controllers.items():
+            for counter, pending in list(controller.pending.items()):
+                if now - pending[2] >= self.timeout:
+                    self._retry(kuka_ip, controller, counter, "TIMED OUT")
+            if (
+                controller.enabled
+                and now - controller.heartbeat >= self.HEARTBEAT_PERIOD
+            ):
+                # Not tracked, the next heartbeat follows anyway
+                controller.packet_sent += 1
+                controller.heartbeat = now
+                self._send(
+                    controller,
+                    controller.packet_sent,
+                    KUKA_INPUT_SIGNAL.APP_ENABLE,
+                    True,
+                )
+
+    def collect(self, counters, timeout=None):
+        """Wait until the requests {kuka_ip: counter} are answered.
+
+        Returns {kuka_ip: KUKA_STATE} of the answered ones, timeout=None waits until
+        all were answered or given up.
+        """
+        waiting = dict(counters)
+        answered = {}
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while waiting:
+            for kuka_ip in list(waiting):
+                controller = self.controllers[kuka_ip]
+                counter = waiting[kuka_ip]
+                if counter in controller.failed:
+                    controller.failed.discard(counter)
+                    del waiting[kuka_ip]
+                elif not any(p[4] == counter for p in controller.pending.values()):
+                    answered[kuka_ip] = controller.state
+                    del waiting[kuka_ip]
+            if not waiting:
+                break
+            wait = self.timeout / 2
+            if deadline is not None:
+                wait = min(wait, deadline - time.monotonic())
+                if wait <= 0:
+                    break
+            if self._selector.select(wait):
+                self.process()
+            self.service()
+        return answered
+
+    def get_states(self, kuka_ips=None, timeout=None):
+        """Poll the state of all (or the given) controllers concurrently."""
+        kuka_ips = self.controllers if kuka_ips is None else kuka_ips
+        return self.collect(
+            {ip: self.request(ip, KUKA_INPUT_SIGNAL.GET_STATE) for ip in kuka_ips},
+            timeout,
+        )
+
+    def app_start(self, kuka_ips=None, with_app_enable=False, timeout=None):
+        """Start the default application, with_app_enable keeps it enabled."""
+        kuka_ips = self.controllers if kuka_ips is None else kuka_ips
+        for kuka_ip in kuka_ips:
+            self.controllers[kuka_ip].enabled = with_app_enable
+        self.service()
+        return self.collect(
+            {ip: self.request(ip, KUKA_INPUT_SIGNAL.APP_START) for ip in kuka_ips},
+            timeout,
+        )
+
+    def app_stop(self, kuka_ips=None, timeout=None):
+        """Pause the applications started with_app_enable."""
+        kuka_ips = self.controllers if kuka_ips is None else kuka_ips
+        for kuka_ip in kuka_ips:
+            self.controllers[kuka_ip].enabled = False
+        return self.collect(
+            {
+                ip: self.request(ip, KUKA_INPUT_SIGNAL.APP_ENABLE, False)
+                for ip in kuka_ips
+            },
+            timeout,
+        )
+
+    def _send(self, controller, counter, input_signal, value):
+        msg = compose_cmd(counter, input_signal, value)
+        if self.verbose:
+            print(f"Sending to {controller.address[0]}: {msg}")
+        try:
+            self._socket.sendto(msg.encode("utf-8"), controller.address)
+        except (BlockingIOError, InterruptedError, ConnectionRefusedError):
+            pass  # repeated after the timeout
+
+    def _retry(self, kuka_ip, controller, counter, reason):
+        # Repeat the request with a new counter, or give it up
+        pending = controller.pending.pop(counter)
+        if pending[3] < self.retries:
+            self._resend(controller, pending)
+        else:
+            print(kuka_ip, f"REQUEST {pending[0].name} {reason}")
+            controller.failed.add(pending[4])
+
+    def _resend(self, controller, pending):
+        input_signal, value, _, attempts, first = pending
+        controller.packet_sent += 1
+        counter = controller.packet_sent
+        controller.pending[counter] = [
+            input_signal,
+            value,
+            time.monotonic(),
+            attempts + 1,
+            first,
+        ]
+        self._send(controller, counter, input_signal, value)
+
+    def _receive(self, kuka_ip, controller, state):
+        controller.state = state
+        if state.error_id == KUKA_ERROR_CODE.INCORRECT_DATA_PACKET_COUNTER.value:
+            # Every pipelined request is rejected with the same controller counter,
+            # so only the first rejection continues from it and repeats what is
+            # pending. A controller that keeps rejecting runs out of retries.
+            if state.packet_received == controller.realigned_from:
+                return
+            controller.realigned_from = state.packet_received
+            controller.packet_sent = max(controller.packet_sent, state.packet_received)
+            for counter in sorted(controller.pending):
+                self._retry(kuka_ip, controller, counter, "REJECTED")
+            return
+        controller.pending.pop(state.packet_received, None)
+
 if __name__ == '__main__':
     kuka = KUKA_UDP(initial_packet_seq=1, verbose=True)
     if kuka.local_ip_check():
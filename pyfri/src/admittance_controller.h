@@ -0,0 +1,182 @@
+#ifndef PYFRI_ADMITTANCE_CONTROLLER_H
+#define PYFRI_ADMITTANCE_CONTROLLER_H
+
+// Standard library
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friLBRClient.h"
+
+#include "kinematics.h"
+#include "mailbox.h"
+#include "native_controllers.h"
+#include "pseudo_inverse.h"
+
+// Hand guiding by admittance control, the native counterpart of
+// examples/hand_guide.py. Every cycle the external joint torque is mapped to
+// a wrench at the tip link, WrenchEstimatorTaskOffset style: the mean over
+// the first offset_samples cycles after commanding starts is subtracted,
+// while the position is held. The wrench is smoothed, a deadband removes
+// small forces and the mass-damper M dv/dt + D v = F gives the tip velocity,
+// which is clipped and resolved into joint steps through the pseudo-inverse
+// of the Jacobian at the commanded position. The commanded position is kept
+// within the joint limits.
+class AdmittanceController : public NativeController {
+
+public:
+  // Task space values use the first TASK_DIMENSION entries, linear first
+  struct Parameters {
+    JointArray mass;         // kg, kgm^2, 0 for a pure damper
+    JointArray damping;      // Ns/m, Nms/rad
+    JointArray threshold;    // N, Nm, deadband of the smoothed wrench
+    JointArray max_velocity; // m/s, rad/s
+    JointArray lower;        // rad, joint limits
+    JointArray upper;
+    double smooth; // exponential smoothing of the wrench, 1 for none
+    double rcond;  // cutoff of small singular values of the Jacobian
+  };
+
+  AdmittanceController(const std::string &robot, const Parameters &parameters,
+                       std::size_t offset_samples = 50)
+      : _kinematics(makeKinematics(robot)), _parameters(parameters),
+        _mailbox(parameters), _offset_samples(offset_samples), _collected(0),
+        _ready(false) {
+    _check(parameters);
+  }
+
+  const char *robot() const { return _kinematics->name(); }
+
+  std::size_t offset_samples() const { return _offset_samples; }
+
+  const Parameters &parameters() const { return _parameters; }
+
+  // Called from Python, takes effect in the next cycle
+  void set_parameters(const Parameters &parameters) {
+    _check(parameters);
+    _parameters = parameters;
+    _mailbox.write(parameters);
+  }
+
+  // Whether the offset was estimated and the robot follows the wrench
+  bool ready() const { return _ready.load(std::memory_order_acquire); }
+
+  void waitForCommand(const KUKA::FRI::LBRState &state,
+                      KUKA::FRI::LBRCommand &command) override {
+    const double *ipo = state.getIpoJointPosition();
+    std::copy(ipo, ipo + KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+              _position.begin());
+    _offset.fill(0.0);
+    _wrench.fill(0.0);
+    _velocity.fill(0.0);
+    _collected = 0;
+    _ready.store(_offset_samples == 0, std::memory_order_release);
+    commandIpoPosition(state, command);
+  }
+
+  void command(const KUKA::FRI::LBRState &state,
+               KUKA::FRI::LBRCommand &command) override {
+    constexpr unsigned int M = TASK_DIMENSION;
+    constexpr unsigned int N = KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+    const Parameters &p = _mailbox.latest();
+    const double dt = state.getSampleTime();
+
+    // Wrench at the measured position
+    double wrench[M];
+    _jacobianInverse(state.getMeasuredJointPosition(), p.rcond);
+    const double *tau = state.getExternalTorque();
+    for (unsigned int c = 0; c < M; ++c) {
+      double sum = 0.0;
+      for (unsigned int j = 0; j < N; ++j)
+        sum += _inverse[j * M + c] * tau[j];
+      wrench[c] = sum;
+    }
+
+    if (_collected < _offset_samples) {
+      for (unsigned int c = 0; c < M; ++c)
+        _offset[c] += wrench[c];
+      if (++_collected == _offset_samples) {
+        for (unsigned int c = 0; c < M; ++c)
+          _offset[c] /= _offset_samples;
+        _ready.store(true, std::memory_order_release);
+      }
+      commandPosition(state, command, _position.data());
+      return;
+    }
+
+    // Tip velocity of the mass-damper driven by the deadbanded wrench
+    double velocity[M];
+    for (unsigned int c = 0; c < M; ++c) {
+      _wrench[c] += p.smooth * (wrench[c] - _offset[c] - _wrench[c]);
+      const double magnitude = std::abs(_wrench[c]) - p.threshold[c];
+      const double force =
+          magnitude > 0.0 ? std::copysign(magnitude, _wrench[c]) : 0.0;
+      if (p.mass[c] > 0.0) // implicit in the damping, stable for any dt
+        _velocity[c] = (p.mass[c] * _velocity[c] + dt * force) /
+                       (p.mass[c] + dt * p.damping[c]);
+      else
+        _velocity[c] = force / p.damping[c];
+      _velocity[c] = std::max(-p.max_velocity[c],
+                              std::min(_velocity[c], p.max_velocity[c]));
+      velocity[c] = _velocity[c];
+    }
+
+    // Joint step at the commanded position
+    _jacobianInverse(_position.data(), p.rcond);
+    for (unsigned int j = 0; j < N; ++j) {
+      double dq = 0.0;
+      for (unsigned int c = 0; c < M; ++c)
+        dq += _inverse[j * M + c] * velocity[c];
+      _position[j] =
+          std::max(p.lower[j], std::min(_position[j] + dt * dq, p.upper[j]));
+    }
+    commandPosition(state, command, _position.data());
+  }
+
+private:
+  std::unique_ptr<Kinematics> _kinematics;
+  Parameters _parameters; // last value written from Python
+  Mailbox<Parameters> _mailbox;
+  std::size_t _offset_samples;
+  std::size_t _collected;
+  std::atomic<bool> _ready;
+
+  JointArray _position = {}; // commanded
+  JointArray _offset = {};   // task space, as the vectors below
+  JointArray _wrench = {};   // smoothed, offset removed
+  JointArray _velocity = {};
+  double _jacobian[TASK_DIMENSION * KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+  double _inverse[KUKA::FRI::LBRState::NUMBER_OF_JOINTS * TASK_DIMENSION];
+
+  void _jacobianInverse(const double *q, double rcond) {
+    _kinematics->jacobian(q, _jacobian);
+    pseudoInverse(_jacobian, rcond, 0.0, _inverse);
+  }
+
+  static void _check(const Parameters &parameters) {
+    for (unsigned int c = 0; c < TASK_DIMENSION; ++c) {
+      if (!(parameters.mass[c] >= 0.0))
+        throw std::runtime_error("mass must not be negative!");
+      if (!(parameters.damping[c] > 0.0))
+        throw std::runtime_error("damping must be positive!");
+      if (!(parameters.threshold[c] >= 0.0) ||
+          !(parameters.max_velocity[c] >= 0.0))
+        throw std::runtime_error(
+            "threshold and max_velocity must not be negative!");
+    }
+    for (unsigned int j = 0; j < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++j)
+      if (!(parameters.lower[j] <= parameters.upper[j]))
+        throw std::runtime_error("lower must not exceed upper!");
+    if (!(parameters.smooth > 0.0 && parameters.smooth <= 1.0))
+      throw std::runtime_error("smooth must be in (0, 1]!");
+    if (!(parameters.rcond >= 0.0 && parameters.rcond < 1.0))
+      throw std::runtime_error("rcond must be in [0, 1)!");
+  }
+};
+
+#endif // PYFRI_ADMITTANCE_CONTROLLER_H
@@ -0,0 +1,96 @@
+#ifndef PYFRI_BATCH_PROCESSING_H
+#define PYFRI_BATCH_PROCESSING_H
+
+// Standard library
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "joint_state_estimator.h"
+
+// Call f(begin, end) for consecutive ranges that cover [0, count), spread over
+// `threads` threads including the calling one, 0 uses one per core. The first
+// exception of a range is rethrown once all threads are joined.
+template <typename F>
+void parallelRanges(std::size_t count, std::size_t threads, F f) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min(threads, count);
+  if (threads <= 1) {
+    if (count > 0)
+      f(std::size_t(0), count);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(threads);
+  auto run = [&](std::size_t t) {
+    try {
+      f(count * t / threads, count * (t + 1) / threads);
+    } catch (...) {
+      errors[t] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  try {
+    for (std::size_t t = 1; t < threads; ++t)
+      workers.emplace_back(run, t);
+  } catch (...) {
+    for (std::thread &worker : workers)
+      worker.join();
+    throw;
+  }
+  run(0);
+  for (std::thread &worker : workers)
+    worker.join();
+  for (const std::exception_ptr &error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+
+// Position, velocity and acceleration (rows x N each) that a fresh estimator
+// configured as `prototype` gives for the joint positions q (rows x N) and the
+// sample times dt[t * dt_stride], i.e. dt_stride 0 for a constant one.
+//
+// Finite differences and Savitzky-Golay fits only look a fixed number of
+// samples back, so the rows are split into ranges over the threads, each
+// estimator starting that many samples before its range. This gives the same
+// values as one pass. The Kalman filter depends on all past samples and runs
+// in one pass.
+inline void estimateJointStates(const JointStateEstimator &prototype,
+                                const double *q, const double *dt,
+                                std::size_t dt_stride, std::size_t rows,
+                                double *position, double *velocity,
+                                double *acceleration, std::size_t threads) {
+  constexpr unsigned int N = JointStateEstimator::N;
+  std::size_t lookback = 0;
+  switch (prototype.method()) {
+  case EstimationMethod::FINITE_DIFFERENCE:
+    lookback = 2;
+    break;
+  case EstimationMethod::SAVITZKY_GOLAY:
+    lookback = prototype.window() - 1;
+    break;
+  case EstimationMethod::KALMAN:
+    threads = 1;
+    break;
+  }
+
+  parallelRanges(rows, threads, [&](std::size_t begin, std::size_t end) {
+    JointStateEstimator estimator(prototype);
+    estimator.reset();
+    for (std::size_t t = begin > lookback ? begin - lookback : 0; t < end;
+         ++t) {
+      estimator.update(q + t * N, dt[t * dt_stride]);
+      if (t < begin)
+        continue;
+      std::copy_n(estimator.position(-1).data(), N, position + t * N);
+      std::copy_n(estimator.velocity(-1).data(), N, velocity + t * N);
+      std::copy_n(estimator.acceleration(-1).data(), N, acceleration + t * N);
+    }
+  });
+}
+
+#endif // PYFRI_BATCH_PROCESSING_H
@@ -0,0 +1,292 @@
+#ifndef PYFRI_COMMAND_DEADLINE_H
+#define PYFRI_COMMAND_DEADLINE_H
+
+// Standard library
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friLBRClient.h"
+
+#include "native_controllers.h"
+#include "pose_conversions.h"
+
+// What is commanded when a callback misses its deadline. In the
+// CARTESIAN_POSE client command mode of FRI 2 these are the last commanded
+// and the interpolated pose.
+enum class DeadlineFallback {
+  HOLD_LAST,   // the last joint position commanded in time
+  IPO_POSITION // the interpolated joint position
+};
+
+#if FRI_CLIENT_VERSION_MAJOR == 2
+// Cartesian pose command [x, y, z, qw, qx, qy, qz] with its optional
+// redundancy value
+struct PoseCommand {
+  std::array<double, QUATERNION_POSE_SIZE> pose;
+  bool has_redundancy;
+  double redundancy;
+
+  void write(KUKA::FRI::LBRCommand &command) const {
+    command.setCartesianPose(pose.data(),
+                             has_redundancy ? &redundancy : nullptr);
+  }
+};
+#endif
+
+// Raised by the command setters of a callback that missed its deadline,
+// after the fallback was sent
+class CommandDeadlineExceeded : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+// Runs the command callbacks on a worker thread with a time budget. The
+// calling FRI thread waits until the callback returns or the budget is spent;
+// in the latter case it closes the command, so that further writes of the
+// late callback raise CommandDeadlineExceeded instead of racing the encoding
+// of the packet, and commands the fallback itself. While the late callback
+// is still running, all further cycles fall back immediately.
+//
+// The command setters take a Write guard, which is a no-op outside the
+// worker thread.
+class CommandDeadline {
+
+public:
+  // Scope of one write to the LBRCommand
+  class Write {
+
+  public:
+    Write() : _deadline(_active) {
+      if (!_deadline)
+        return;
+      _deadline->_command_mutex.lock();
+      if (_deadline->_closed) {
+        _deadline->_cut = true;
+        _deadline->_command_mutex.unlock();
+        throw CommandDeadlineExceeded(
+            "The command deadline has passed, the fallback was sent!");
+      }
+    }
+
+    ~Write() {
+      if (_deadline)
+        _deadline->_command_mutex.unlock();
+    }
+
+    Write(const Write &) = delete;
+    Write &operator=(const Write &) = delete;
+
+    // Remember a joint position command for HOLD_LAST
+    void position(const double *position) {
+      if (!_deadline)
+        return;
+      std::copy(position, position + KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+                _deadline->_pending.begin());
+      _deadline->_has_pending = true;
+    }
+
+#if FRI_CLIENT_VERSION_MAJOR == 2
+    // Remember a Cartesian pose command for HOLD_LAST, redundancy may be null
+    void pose(const double *pose, const double *redundancy) {
+      if (!_deadline)
+        return;
+      PoseCommand &pending = _deadline->_pending_pose;
+      std::copy(pose, pose + QUATERNION_POSE_SIZE, pending.pose.begin());
+      pending.has_redundancy = redundancy != nullptr;
+      pending.redundancy = redundancy ? *redundancy : 0.0;
+      _deadline->_has_pending_pose = true;
+    }
+#endif
+
+  private:
+    CommandDeadline *_deadline;
+  };
+
+  CommandDeadline(long long budget_us, DeadlineFallback fallback)
+      : _budget(budget_us), _fallback(fallback), _stop(false), _busy(false),
+        _finished(false), _closed(true), _cut(false), _has_pending(false),
+        _has_pending_pose(false), _has_last(false), _has_last_pose(false),
+        _overruns(0) {
+    if (budget_us <= 0)
+      throw std::runtime_error("budget_us must be positive!");
+    _thread = std::thread(&CommandDeadline::_work, this);
+  }
+
+  // Waits for a late callback to return
+  ~CommandDeadline() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _wake.notify_one();
+    _thread.join();
+  }
+
+  CommandDeadline(const CommandDeadline &) = delete;
+  CommandDeadline &operator=(const CommandDeadline &) = delete;
+
+  long long budget_us() const { return _budget.count(); }
+
+  DeadlineFallback fallback() const { return _fallback; }
+
+  // Cycles commanded by the fallback
+  unsigned long long overruns() const {
+    return _overruns.load(std::memory_order_relaxed);
+  }
+
+  // Forget the last position and pose, e.g. when commanding starts
+  void restart() {
+    _has_last = false;
+    _has_last_pose = false;
+  }
+
+  // Called from the FRI thread, which must not hold a lock the callback
+  // needs (e.g. the GIL). Rethrows the callback's exception if it returned
+  // in time, or that of a late callback in the next cycle.
+  void run(const std::function<void()> &callback,
+           const KUKA::FRI::LBRState &state, KUKA::FRI::LBRCommand &command) {
+    const auto deadline = std::chrono::steady_clock::now() + _budget;
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_error) {
+      std::exception_ptr error = std::move(_error);
+      _error = nullptr;
+      std::rethrow_exception(error);
+    }
+    if (_busy) {
+      // The previous callback is still running
+      lock.unlock();
+      _commandFallback(state, command);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> command_lock(_command_mutex);
+      _closed = false;
+      _has_pending = false;
+      _has_pending_pose = false;
+    }
+    _callback = callback; // outlives the call if the callback is late
+    _busy = true;
+    _finished = false;
+    _wake.notify_one();
+
+    if (_done.wait_until(lock, deadline, [this] { return _finished; })) {
+      _closed = true; // the worker is idle, no write can be in progress
+      if (_has_pending) {
+        _last = _pending;
+        _has_last = true;
+      }
+      if (_has_pending_pose) {
+#if FRI_CLIENT_VERSION_MAJOR == 2
+        _last_pose = _pending_pose;
+#endif
+        _has_last_pose = true;
+      }
+      if (_error) {
+        std::exception_ptr error = std::move(_error);
+        _error = nullptr;
+        std::rethrow_exception(error);
+      }
+      return;
+    }
+    lock.unlock();
+
+    // Waits for a write in progress
+    {
+      std::lock_guard<std::mutex> command_lock(_command_mutex);
+      _closed = true;
+    }
+    _commandFallback(state, command);
+  }
+
+private:
+  // The deadline whose worker is the current thread
+  static inline thread_local CommandDeadline *_active = nullptr;
+
+  std::chrono::microseconds _budget;
+  DeadlineFallback _fallback;
+  std::thread _thread;
+  std::mutex _mutex; // guards the fields up to _error
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  bool _stop;
+  bool _busy;     // a callback is running, set until it returns
+  bool _finished; // the current callback returned
+  std::function<void()> _callback;
+  std::exception_ptr _error;
+
+  std::mutex _command_mutex; // held by every Write
+  bool _closed;
+  bool _cut; // worker only, a write of the callback was refused
+  JointArray _pending; // position written by the current callback
+  bool _has_pending;
+#if FRI_CLIENT_VERSION_MAJOR == 2
+  PoseCommand _pending_pose; // pose written by the current callback
+#endif
+  bool _has_pending_pose;
+
+  JointArray _last; // FRI thread only, as _last_pose
+  bool _has_last;
+#if FRI_CLIENT_VERSION_MAJOR == 2
+  PoseCommand _last_pose;
+#endif
+  bool _has_last_pose;
+  std::atomic<unsigned long long> _overruns;
+
+  void _commandFallback(const KUKA::FRI::LBRState &state,
+                        KUKA::FRI::LBRCommand &command) {
+    _overruns.fetch_add(1, std::memory_order_relaxed);
+#if FRI_CLIENT_VERSION_MAJOR == 2
+    if (commandsCartesianPose(state)) {
+      if (_fallback == DeadlineFallback::HOLD_LAST && _has_last_pose)
+        _last_pose.write(command);
+      else
+        commandIpoPosition(state, command); // the interpolated pose
+      return;
+    }
+#endif
+    if (_fallback == DeadlineFallback::HOLD_LAST && _has_last)
+      commandPosition(state, command, _last.data());
+    else
+      commandIpoPosition(state, command);
+  }
+
+  void _work() {
+    _active = this;
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+      _wake.wait(lock, [this] { return _stop || (_busy && !_finished); });
+      if (_stop)
+        return;
+      lock.unlock();
+
+      // A refused write surfaces as whatever the callback (or Python) makes
+      // of CommandDeadlineExceeded
+      std::exception_ptr error;
+      _cut = false;
+      try {
+        _callback();
+      } catch (...) {
+        if (!_cut)
+          error = std::current_exception();
+      }
+
+      lock.lock();
+      _error = std::move(error);
+      _finished = true;
+      _busy = false;
+      _done.notify_one();
+    }
+  }
+};
+
+#endif // PYFRI_COMMAND_DEADLINE_H
@@ -0,0 +1,486 @@
+#ifndef PYFRI_CONNECTIONS_H
+#define PYFRI_CONNECTIONS_H
+
+// Standard library
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friConnectionIf.h"
+
+#include "cycle_statistics.h"
+#include "ring_buffer.h"
+
+// File of raw FRI packets as received from the controller, written by the
+// RecordingConnection and read by the ReplayConnection. All values are
+// little-endian.
+//
+//   offset  size  content
+//   0       8     magic "PYFRIPKT"
+//   8       4     format version (uint32)
+//   12      4     reserved
+//   16      ...   packets: uint32 size, uint32 reserved, int64 receive time
+//                 (ns since the epoch, steady clock in version 1), then size
+//                 bytes zero padded to a multiple of 8
+namespace packet_file {
+
+constexpr char MAGIC[8] = {'P', 'Y', 'F', 'R', 'I', 'P', 'K', 'T'};
+constexpr std::uint32_t VERSION = 2;
+constexpr std::size_t HEADER_SIZE = 16;
+
+// Largest packet that is recorded, the controller fits its messages into a
+// single Ethernet frame
+constexpr std::size_t MAX_PACKET_SIZE = 1500;
+
+inline std::size_t paddedSize(std::size_t size) { return (size + 7) / 8 * 8; }
+
+} // namespace packet_file
+
+// Connection that knows when the last packet was received and the last
+// reply was sent
+class TimestampedConnection {
+
+public:
+  virtual ~TimestampedConnection() {}
+
+  virtual const PacketTimestamps &timestamps() const = 0;
+};
+
+// Connection with a socket that can be waited on before receive(), e.g. by
+// the MultiClientApplication, selectors or asyncio
+class PollableConnection : public KUKA::FRI::IConnection,
+                           public TimestampedConnection {
+
+public:
+  // File descriptor of the socket, -1 while closed
+  virtual int fileno() const = 0;
+
+  // Incremented by every open(), tells a reused descriptor number apart
+  virtual unsigned long long generation() const = 0;
+
+  // Wait until a packet can be received, timeout_ms < 0 waits indefinitely.
+  // Returns false on timeout or if the connection is closed.
+  virtual bool wait(int timeout_ms) const = 0;
+};
+
+// UDP connection with the semantics of KUKA::FRI::UdpConnection (bind to the
+// port, answer the sender of the last packet or only talk to remoteHost if
+// given), but with the socket exposed so that it can be waited on. Where
+// supported (Linux) the receive time is taken by the kernel (SO_TIMESTAMPNS)
+// so that it excludes the scheduling delay of the FRI thread.
+class SocketConnection : public PollableConnection {
+
+public:
+  // receive_timeout in ms, 0 waits indefinitely
+  SocketConnection(unsigned int receive_timeout = 0)
+      : _receive_timeout(receive_timeout), _socket(-1), _generation(0),
+        _filter(false) {}
+
+  ~SocketConnection() { close(); }
+
+  SocketConnection(const SocketConnection &) = delete;
+  SocketConnection &operator=(const SocketConnection &) = delete;
+
+  unsigned int receive_timeout() const { return _receive_timeout; }
+
+  int fileno() const override { return _socket; }
+
+  unsigned long long generation() const override { return _generation; }
+
+  const PacketTimestamps &timestamps() const override { return _timestamps; }
+
+  bool open(int port, const char *remoteHost) override {
+#ifdef _WIN32
+    throw std::runtime_error(
+        "SocketConnection is only supported on POSIX systems.");
+#else
+    close();
+    _generation++;
+    _socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (_socket < 0)
+      return false;
+    _timestamps = {};
+#ifdef SO_TIMESTAMPNS
+    // Without kernel timestamps receive() falls back to the time of recvmsg
+    const int enable = 1;
+    ::setsockopt(_socket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+#endif
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (::bind(_socket, reinterpret_cast<sockaddr *>(&address),
+               sizeof(address)) < 0) {
+      close();
+      return false;
+    }
+
+    _controller = {};
+    _controller.sin_family = AF_INET;
+    _controller.sin_port = htons(port);
+    _filter = remoteHost != nullptr;
+    if (_filter &&
+        ::inet_pton(AF_INET, remoteHost, &_controller.sin_addr) != 1) {
+      close();
+      return false;
+    }
+    return true;
+#endif
+  }
+
+  void close() override {
+#ifndef _WIN32
+    if (_socket >= 0)
+      ::close(_socket);
+#endif
+    _socket = -1;
+  }
+
+  bool isOpen() const override { return _socket >= 0; }
+
+  bool wait(int timeout_ms) const override {
+#ifdef _WIN32
+    return false;
+#else
+    if (_socket < 0)
+      return false;
+    pollfd fd = {_socket, POLLIN, 0};
+    int ready;
+    do
+      ready = ::poll(&fd, 1, timeout_ms);
+    while (ready < 0 && errno == EINTR);
+    return ready > 0;
+#endif
+  }
+
+  int receive(char *buffer, int maxSize) override {
+#ifdef _WIN32
+    return -1;
+#else
+    if (_receive_timeout > 0 && !wait(_receive_timeout))
+      return -1;
+    while (_socket >= 0) {
+      sockaddr_in sender = {};
+      iovec data = {buffer, static_cast<std::size_t>(maxSize)};
+      alignas(cmsghdr) char control[CMSG_SPACE(sizeof(timespec))];
+      msghdr message = {};
+      message.msg_name = &sender;
+      message.msg_namelen = sizeof(sender);
+      message.msg_iov = &data;
+      message.msg_iovlen = 1;
+      message.msg_control = control;
+      message.msg_controllen = sizeof(control);
+      const ssize_t size = ::recvmsg(_socket, &message, 0);
+      if (size < 0) {
+        if (errno == EINTR)
+          continue;
+        return -1;
+      }
+      // Ignore packets from anyone but the configured controller
+      if (_filter && sender.sin_addr.s_addr != _controller.sin_addr.s_addr)
+        continue;
+      _controller = sender;
+      _timestamps.receive = _receiveTime(message, _timestamps.kernel);
+      return static_cast<int>(size);
+    }
+    return -1;
+#endif
+  }
+
+  bool send(const char *buffer, int size) override {
+#ifdef _WIN32
+    return false;
+#else
+    if (_socket < 0)
+      return false;
+    const bool sent =
+        ::sendto(_socket, buffer, size, 0,
+                 reinterpret_cast<const sockaddr *>(&_controller),
+                 sizeof(_controller)) == size;
+    _timestamps.send = realtimeInNanoseconds();
+    return sent;
+#endif
+  }
+
+private:
+  unsigned int _receive_timeout;
+  int _socket;
+  unsigned long long _generation;
+#ifndef _WIN32
+  sockaddr_in _controller; // where commands are sent
+#endif
+  bool _filter; // only accept packets from the configured controller
+  PacketTimestamps _timestamps;
+
+#ifndef _WIN32
+  static long long _receiveTime(msghdr &message, bool &kernel) {
+#ifdef SCM_TIMESTAMPNS
+    for (cmsghdr *header = CMSG_FIRSTHDR(&message); header;
+         header = CMSG_NXTHDR(&message, header)) {
+      if (header->cmsg_level == SOL_SOCKET &&
+          header->cmsg_type == SCM_TIMESTAMPNS) {
+        timespec time;
+        std::memcpy(&time, CMSG_DATA(header), sizeof(time));
+        kernel = true;
+        return time.tv_sec * 1000000000LL + time.tv_nsec;
+      }
+    }
+#endif
+    kernel = false;
+    return realtimeInNanoseconds();
+  }
+#endif
+};
+
+// SocketConnection that also records every received packet. As in the
+// DataRecorder, packets are copied into a preallocated ring buffer and a
+// background thread writes them to disk, so recording adds a memcpy to the
+// FRI cycle.
+class RecordingConnection : public PollableConnection {
+
+public:
+  // Number of packets that can be buffered (about 4 s at 1 kHz)
+  static constexpr std::size_t BUFFER_CAPACITY = 1 << 12;
+
+  // How often the background thread drains the buffer
+  static constexpr std::chrono::milliseconds DRAIN_PERIOD{5};
+
+  RecordingConnection(const std::string &file_name,
+                      unsigned int receive_timeout = 0)
+      : _connection(receive_timeout), _file_name(file_name),
+        _buffer(BUFFER_CAPACITY,
+                2 + packet_file::paddedSize(packet_file::MAX_PACKET_SIZE) /
+                        sizeof(std::uint64_t)),
+        _running(false), _packets(0), _dropped(0) {}
+
+  ~RecordingConnection() { close(); }
+
+  const std::string &file_name() const { return _file_name; }
+
+  unsigned long long recorded_packets() const { return _packets; }
+
+  unsigned long long dropped_packets() const { return _dropped; }
+
+  // Opens the socket and starts a new recording
+  bool open(int port, const char *remoteHost) override {
+    close();
+    _file.open(_file_name, std::ios::binary | std::ios::trunc);
+    if (!_file.is_open())
+      throw std::runtime_error("Failed to open packet file " + _file_name +
+                               ".");
+
+    char header[packet_file::HEADER_SIZE] = {};
+    const std::uint32_t version = packet_file::VERSION;
+    std::memcpy(header, packet_file::MAGIC, sizeof(packet_file::MAGIC));
+    std::memcpy(header + 8, &version, sizeof(version));
+    _file.write(header, sizeof(header));
+
+    _packets = 0;
+    _dropped = 0;
+    _running = true;
+    _thread = std::thread(&RecordingConnection::_drain, this);
+    return _connection.open(port, remoteHost);
+  }
+
+  void close() override {
+    _connection.close();
+    if (!_thread.joinable())
+      return;
+    _running = false;
+    _thread.join();
+    _file.close();
+  }
+
+  bool isOpen() const override { return _connection.isOpen(); }
+
+  int fileno() const override { return _connection.fileno(); }
+
+  unsigned long long generation() const override {
+    return _connection.generation();
+  }
+
+  bool wait(int timeout_ms) const override {
+    return _connection.wait(timeout_ms);
+  }
+
+  const PacketTimestamps &timestamps() const override {
+    return _connection.timestamps();
+  }
+
+  int receive(char *buffer, int maxSize) override {
+    const int size = _connection.receive(buffer, maxSize);
+    if (size <= 0)
+      return size;
+
+    std::uint64_t *record = _buffer.claim();
+    if (record &&
+        static_cast<std::size_t>(size) <= packet_file::MAX_PACKET_SIZE) {
+      record[0] = static_cast<std::uint64_t>(size);
+      const std::int64_t time = _connection.timestamps().receive;
+      std::memcpy(record + 1, &time, sizeof(time));
+      std::memcpy(record + 2, buffer, size);
+      _buffer.commit();
+      _packets++;
+    } else {
+      _dropped++;
+    }
+    return size;
+  }
+
+  bool send(const char *buffer, int size) override {
+    return _connection.send(buffer, size);
+  }
+
+private:
+  SocketConnection _connection;
+  std::string _file_name;
+  std::ofstream _file;
+  RingBuffer _buffer;
+  std::thread _thread;
+  std::atomic<bool> _running;
+  std::atomic<unsigned long long> _packets;
+  std::atomic<unsigned long long> _dropped;
+
+  void _flush() {
+    std::size_t n;
+    while ((n = _buffer.available()) > 0) {
+      for (std::size_t i = 0; i < n; ++i) {
+        const std::uint64_t *record = _buffer.peek(i);
+        const std::uint32_t header[2] = {static_cast<std::uint32_t>(record[0]),
+                                         0};
+        const std::size_t size = header[0];
+        const char padding[8] = {};
+        _file.write(reinterpret_cast<const char *>(header), sizeof(header));
+        _file.write(reinterpret_cast<const char *>(record + 1), 8);
+        _file.write(reinterpret_cast<const char *>(record + 2), size);
+        _file.write(padding, packet_file::paddedSize(size) - size);
+      }
+      _buffer.release(n);
+    }
+  }
+
+  void _drain() {
+    while (_running) {
+      _flush();
+      std::this_thread::sleep_for(DRAIN_PERIOD);
+    }
+    _flush();
+  }
+};
+
+// Replays a packet file into the ClientApplication instead of talking to a
+// controller. The packets are loaded on construction and handed out by
+// receive() without waiting, so the client callbacks run as fast as the CPU
+// allows. Commands sent by the client are counted and discarded. Once all
+// packets are replayed receive() fails and step() returns false. The
+// timestamps report the recorded receive times, nothing is sent.
+class ReplayConnection : public KUKA::FRI::IConnection,
+                         public TimestampedConnection {
+
+public:
+  ReplayConnection(const std::string &file_name)
+      : _open(false), _next(0), _sent(0) {
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file.is_open())
+      throw std::runtime_error("Failed to open packet file " + file_name +
+                               ".");
+
+    char header[packet_file::HEADER_SIZE] = {};
+    file.read(header, sizeof(header));
+    std::uint32_t version = 0;
+    std::memcpy(&version, header + 8, sizeof(version));
+    if (!file ||
+        std::memcmp(header, packet_file::MAGIC, sizeof(packet_file::MAGIC)))
+      throw std::runtime_error(file_name + " is not a pyfri packet file.");
+    if (version != 1 && version != packet_file::VERSION)
+      throw std::runtime_error("Unsupported packet file version " +
+                               std::to_string(version) + ".");
+
+    std::uint32_t packet_header[4]; // size, reserved, receive time
+    while (file.read(reinterpret_cast<char *>(packet_header),
+                     sizeof(packet_header))) {
+      const std::size_t size = packet_header[0];
+      const std::size_t offset = _data.size();
+      std::int64_t time;
+      std::memcpy(&time, packet_header + 2, sizeof(time));
+      _data.resize(offset + packet_file::paddedSize(size));
+      if (!file.read(_data.data() + offset, packet_file::paddedSize(size)))
+        throw std::runtime_error("Truncated packet in " + file_name + ".");
+      _packets.push_back({offset, size, time});
+    }
+  }
+
+  // Number of packets in the file
+  std::size_t packets() const { return _packets.size(); }
+
+  // Number of packets replayed and commands sent since open()
+  std::size_t received() const { return _next; }
+
+  std::size_t sent() const { return _sent; }
+
+  const PacketTimestamps &timestamps() const override { return _timestamps; }
+
+  // Restarts the replay, port and host are ignored
+  bool open(int, const char *) override {
+    _open = true;
+    _next = 0;
+    _sent = 0;
+    _timestamps = {};
+    return true;
+  }
+
+  void close() override { _open = false; }
+
+  bool isOpen() const override { return _open; }
+
+  int receive(char *buffer, int maxSize) override {
+    if (!_open || _next == _packets.size())
+      return -1;
+    const Packet &packet = _packets[_next++];
+    if (packet.size > static_cast<std::size_t>(maxSize))
+      return -1;
+    std::memcpy(buffer, _data.data() + packet.offset, packet.size);
+    _timestamps.receive = packet.time;
+    return static_cast<int>(packet.size);
+  }
+
+  bool send(const char *, int) override {
+    _sent++;
+    return _open;
+  }
+
+private:
+  struct Packet {
+    std::size_t offset;
+    std::size_t size;
+    std::int64_t time;
+  };
+
+  bool _open;
+  std::vector<char> _data;
+  std::vector<Packet> _packets;
+  std::size_t _next;
+  std::size_t _sent;
+  PacketTimestamps _timestamps;
+};
+
+#endif // PYFRI_CONNECTIONS_H
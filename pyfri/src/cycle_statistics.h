@@ -0,0 +1,221 @@
+#ifndef PYFRI_CYCLE_STATISTICS_H
+#define PYFRI_CYCLE_STATISTICS_H
+
+// Standard library
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Monotonic time for measuring intervals
+inline long long steadyTimeInNanoseconds() {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Wall-clock time, comparable with the controller timestamps if the clocks
+// are synchronized
+inline long long realtimeInNanoseconds() {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Host time of the last packet received from and the last reply sent to the
+// controller, ns since the epoch, 0 if unknown
+struct PacketTimestamps {
+  long long receive = 0;
+  long long send = 0;
+  bool kernel = false; // receive was taken by the kernel on arrival
+};
+
+// Start and end of the client callback run during the last step()
+struct CallbackTime {
+  long long begin = 0;
+  long long end = 0;
+  bool valid = false;
+};
+
+// Measures a client callback for the duration of its scope
+class CallbackTimer {
+
+public:
+  CallbackTimer(CallbackTime &time) : _time(time) {
+    _time.begin = steadyTimeInNanoseconds();
+  }
+
+  ~CallbackTimer() {
+    _time.end = steadyTimeInNanoseconds();
+    _time.valid = true;
+  }
+
+private:
+  CallbackTime &_time;
+};
+
+// Fixed-bucket histogram of durations with 1 us resolution up to
+// BUCKETS us, longer durations fall into an overflow bucket. Samples are
+// added by a single thread, other threads may read a summary at any time.
+class Histogram {
+
+public:
+  static constexpr std::size_t BUCKETS = 4096;
+
+  struct Summary {
+    unsigned long long count;
+    double mean; // us
+    double p50;  // us, upper edge of the bucket
+    double p99;  // us, upper edge of the bucket
+    double max;  // us
+  };
+
+  Histogram() { reset(); }
+
+  void add(long long ns) {
+    if (ns < 0)
+      ns = 0;
+    const std::size_t bucket = static_cast<std::size_t>(ns / 1000);
+    _increment(_buckets[bucket < BUCKETS ? bucket : BUCKETS], 1);
+    _increment(_count, 1);
+    _increment(_sum, ns);
+    if (static_cast<unsigned long long>(ns) > _max.load(RELAXED))
+      _max.store(ns, RELAXED);
+  }
+
+  void reset() {
+    for (auto &bucket : _buckets)
+      bucket.store(0, RELAXED);
+    _count.store(0, RELAXED);
+    _sum.store(0, RELAXED);
+    _max.store(0, RELAXED);
+  }
+
+  Summary summary() const {
+    Summary summary;
+    summary.count = _count.load(RELAXED);
+    summary.max = _max.load(RELAXED) * 1e-3;
+    summary.mean =
+        summary.count > 0 ? _sum.load(RELAXED) * 1e-3 / summary.count : 0.0;
+    summary.p50 = _percentile(0.5, summary);
+    summary.p99 = _percentile(0.99, summary);
+    return summary;
+  }
+
+private:
+  static constexpr std::memory_order RELAXED = std::memory_order_relaxed;
+
+  std::array<std::atomic<unsigned long long>, BUCKETS + 1> _buckets;
+  std::atomic<unsigned long long> _count;
+  std::atomic<unsigned long long> _sum; // ns
+  std::atomic<unsigned long long> _max; // ns
+
+  // Single writer, so a plain load/store avoids locked instructions
+  static void _increment(std::atomic<unsigned long long> &value,
+                         unsigned long long n) {
+    value.store(value.load(RELAXED) + n, RELAXED);
+  }
+
+  double _percentile(double q, const Summary &summary) const {
+    if (summary.count == 0)
+      return 0.0;
+    const unsigned long long rank =
+        static_cast<unsigned long long>(q * (summary.count - 1)) + 1;
+    unsigned long long seen = 0;
+    for (std::size_t i = 0; i < BUCKETS; ++i) {
+      seen += _buckets[i].load(RELAXED);
+      if (seen >= rank)
+        return static_cast<double>(i + 1);
+    }
+    return summary.max;
+  }
+};
+
+// Timing of the FRI cycle, split into waiting for and decoding the
+// controller's packet (receive), the client callback (callback) and encoding
+// and sending the reply (send), plus the period between packets measured at
+// the start of the callback. With packet timestamps from the connection the
+// host's turnaround, from the packet's arrival to sending the reply, is
+// measured as well.
+class CycleStatistics {
+
+public:
+  CycleStatistics() : _reset_requested(false), _previous_begin(0) { _clear(); }
+
+  // Called by the thread running step()
+  void record(long long step_begin, const CallbackTime &times,
+              long long step_end, double sample_time,
+              const PacketTimestamps &packet = PacketTimestamps()) {
+    if (_reset_requested.exchange(false, std::memory_order_acquire))
+      _clear();
+
+    // Nothing is sent back in IDLE, and the gap to the next session is not
+    // a period
+    if (!times.valid) {
+      _previous_begin = 0;
+      return;
+    }
+
+    const long long sample_ns = static_cast<long long>(sample_time * 1e9);
+
+    receive.add(times.begin - step_begin);
+    callback.add(times.end - times.begin);
+    send.add(step_end - times.end);
+    if (packet.receive > 0 && packet.send >= packet.receive)
+      turnaround.add(packet.send - packet.receive);
+
+    // The reply is late if it took longer than a sample to produce
+    if (step_end - times.begin > sample_ns)
+      _deadline_misses.fetch_add(1, std::memory_order_relaxed);
+
+    if (_previous_begin > 0) {
+      const long long period_ns = times.begin - _previous_begin;
+      period.add(period_ns);
+      if (2 * period_ns > 3 * sample_ns)
+        _period_overruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    _previous_begin = times.begin;
+  }
+
+  // Called by the thread running step() between sessions, the next cycle
+  // starts a new period
+  void restart() { _previous_begin = 0; }
+
+  // Called from any thread, takes effect with the next recorded cycle
+  void reset() { _reset_requested.store(true, std::memory_order_release); }
+
+  // Cycles whose reply took longer than the sample time
+  unsigned long long deadline_misses() const {
+    return _deadline_misses.load(std::memory_order_relaxed);
+  }
+
+  // Packets that arrived more than 1.5 sample times after the previous one
+  unsigned long long period_overruns() const {
+    return _period_overruns.load(std::memory_order_relaxed);
+  }
+
+  Histogram receive;
+  Histogram callback;
+  Histogram send;
+  Histogram period;
+  Histogram turnaround;
+
+private:
+  std::atomic<bool> _reset_requested;
+  std::atomic<unsigned long long> _deadline_misses;
+  std::atomic<unsigned long long> _period_overruns;
+  long long _previous_begin;
+
+  void _clear() {
+    receive.reset();
+    callback.reset();
+    send.reset();
+    period.reset();
+    turnaround.reset();
+    _deadline_misses.store(0, std::memory_order_relaxed);
+    _period_overruns.store(0, std::memory_order_relaxed);
+    _previous_begin = 0;
+  }
+};
+
+#endif // PYFRI_CYCLE_STATISTICS_H
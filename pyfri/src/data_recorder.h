@@ -0,0 +1,787 @@
+#ifndef PYFRI_DATA_RECORDER_H
+#define PYFRI_DATA_RECORDER_H
+
+// Standard library
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friLBRState.h"
+
+#include "cycle_statistics.h"
+#include "ring_buffer.h"
+#include "state_signals.h"
+
+long long getCurrentTimeInNanoseconds();
+
+// Output format of the data recorder
+enum class RecordingFormat { CSV, BINARY, COLUMNAR };
+
+// Type of a recorded column. Every value is stored in an 8-byte word.
+enum class ColumnType : std::uint32_t { INT64 = 0, FLOAT64 = 1 };
+
+struct RecordColumn {
+  std::string name;
+  ColumnType type;
+};
+
+inline std::uint64_t packInt64(std::int64_t value) {
+  std::uint64_t word;
+  std::memcpy(&word, &value, sizeof(word));
+  return word;
+}
+
+inline std::uint64_t packFloat64(double value) {
+  std::uint64_t word;
+  std::memcpy(&word, &value, sizeof(word));
+  return word;
+}
+
+inline std::int64_t unpackInt64(std::uint64_t word) {
+  std::int64_t value;
+  std::memcpy(&value, &word, sizeof(value));
+  return value;
+}
+
+inline double unpackFloat64(std::uint64_t word) {
+  double value;
+  std::memcpy(&value, &word, sizeof(value));
+  return value;
+}
+
+// Copies a signal from the state into consecutive words of a sample
+using RecordCopy = void (*)(const KUKA::FRI::LBRState &state,
+                            const std::string &io, std::uint64_t *words);
+
+// Copies a signal of the connection instead of the state
+using PacketCopy = void (*)(const PacketTimestamps &packet,
+                            std::uint64_t *words);
+
+// Signal of the robot state that is recorded into one or more columns
+struct RecordSignal {
+  std::string name;
+  std::vector<RecordColumn> columns;
+  RecordCopy copy;
+  std::string io; // IO name of the analog:, digital: and boolean: signals
+  PacketCopy packet_copy = nullptr; // used instead of copy if set
+};
+
+// Signals recorded unless others are selected
+inline std::vector<std::string> defaultRecordSignals() {
+  return {"mp", "ip", "mt", "et", "dt"};
+}
+
+// Look up a signal by name. The array signals of StateSignals are recorded
+// into the columns <name>1 ... <name>7 (joints) or <name>_x ... (poses), IO
+// signals (e.g. "analog:name") into a column named after the IO.
+inline RecordSignal recordSignal(const std::string &name) {
+  using KUKA::FRI::LBRState;
+
+  RecordSignal signal{name, {}, nullptr, ""};
+  auto scalar = [&](RecordCopy copy, ColumnType type) {
+    signal.columns.push_back({name, type});
+    signal.copy = copy;
+    return signal;
+  };
+
+  bool found = false;
+  forEachSignal<StateSignals>([&](auto array) {
+    using Signal = decltype(array);
+    if (found || name != Signal::RECORD_NAME)
+      return;
+    for (unsigned int i = 0; i < Signal::SIZE; ++i)
+      signal.columns.push_back({Signal::column(name, i), ColumnType::FLOAT64});
+    signal.copy = [](const LBRState &state, const std::string &,
+                     std::uint64_t *words) {
+      Signal::copyWords(state, words);
+    };
+    found = true;
+  });
+  if (found)
+    return signal;
+#if FRI_CLIENT_VERSION_MAJOR == 2
+  if (name == "redundancy")
+    return scalar(
+        [](const LBRState &state, const std::string &, std::uint64_t *words) {
+          words[0] = packFloat64(state.getMeasuredRedundancyValue());
+        },
+        ColumnType::FLOAT64);
+#endif
+  if (name == "dt")
+    return scalar(
+        [](const LBRState &state, const std::string &, std::uint64_t *words) {
+          words[0] = packFloat64(state.getSampleTime());
+        },
+        ColumnType::FLOAT64);
+  if (name == "tp")
+    return scalar(
+        [](const LBRState &state, const std::string &, std::uint64_t *words) {
+          words[0] = packFloat64(state.getTrackingPerformance());
+        },
+        ColumnType::FLOAT64);
+  if (name == "packet") {
+    signal.columns = {{"receive_time_nsec", ColumnType::INT64},
+                      {"send_time_nsec", ColumnType::INT64}};
+    signal.packet_copy = [](const PacketTimestamps &packet,
+                            std::uint64_t *words) {
+      words[0] = packInt64(packet.receive);
+      words[1] = packInt64(packet.send);
+    };
+    return signal;
+  }
+
+  // IO signals
+  const std::size_t colon = name.find(':');
+  if (colon != std::string::npos && colon + 1 < name.size()) {
+    const std::string kind = name.substr(0, colon);
+    signal.io = name.substr(colon + 1);
+    signal.columns.push_back({signal.io, ColumnType::FLOAT64});
+    if (kind == "analog") {
+      signal.copy = [](const LBRState &state, const std::string &io,
+                       std::uint64_t *words) {
+        words[0] = packFloat64(state.getAnalogIOValue(io.c_str()));
+      };
+      return signal;
+    }
+    signal.columns.back().type = ColumnType::INT64;
+    if (kind == "digital") {
+      signal.copy = [](const LBRState &state, const std::string &io,
+                       std::uint64_t *words) {
+        words[0] = packInt64(state.getDigitalIOValue(io.c_str()));
+      };
+      return signal;
+    }
+    if (kind == "boolean") {
+      signal.copy = [](const LBRState &state, const std::string &io,
+                       std::uint64_t *words) {
+        words[0] = packInt64(state.getBooleanIOValue(io.c_str()));
+      };
+      return signal;
+    }
+  }
+
+  throw std::runtime_error("Unknown signal '" + name + "'.");
+}
+
+// Look up the signals by name, each may only be selected once
+inline std::vector<RecordSignal>
+recordSignals(const std::vector<std::string> &names) {
+  std::vector<RecordSignal> signals;
+  for (const std::string &name : names) {
+    for (const RecordSignal &signal : signals)
+      if (signal.name == name)
+        throw std::runtime_error("Signal '" + name + "' is selected twice.");
+    signals.push_back(recordSignal(name));
+  }
+  return signals;
+}
+
+// The IO names are configured on the controller and the SDK getters throw a
+// KUKA::FRI::FRIException for unknown ones, so the IO signals are read once
+// from a received state before they are recorded
+inline void checkRecordIO(const KUKA::FRI::LBRState &state,
+                          const std::vector<RecordSignal> &signals) {
+  std::uint64_t word;
+  for (const RecordSignal &signal : signals) {
+    if (signal.io.empty())
+      continue;
+    try {
+      signal.copy(state, signal.io, &word);
+    } catch (...) {
+      throw std::invalid_argument("Unknown IO '" + signal.io +
+                                  "' of signal '" + signal.name + "'.");
+    }
+  }
+}
+
+// Columns of a recorded sample, in the order they are stored: the sample
+// counters and controller time, then the columns of every signal
+inline std::vector<RecordColumn>
+recordColumns(const std::vector<RecordSignal> &signals) {
+  std::vector<RecordColumn> columns = {
+      {"index", ColumnType::INT64},
+      {"time", ColumnType::FLOAT64},
+      {"record_time_nsec", ColumnType::INT64},
+      {"tsec", ColumnType::INT64},
+      {"tnsec", ColumnType::INT64},
+  };
+
+  for (const RecordSignal &signal : signals)
+    columns.insert(columns.end(), signal.columns.begin(),
+                   signal.columns.end());
+  return columns;
+}
+
+// Writes recorded samples to disk, used by the background thread of the
+// DataRecorder and for offline conversion.
+class RecordWriter {
+
+public:
+  virtual ~RecordWriter() {}
+
+  virtual void write(const std::uint64_t *rows, std::size_t n) = 0;
+
+  virtual void close() = 0;
+};
+
+// Comma-separated values, one sample per line with a header line holding the
+// column names.
+class CsvRecordWriter : public RecordWriter {
+
+public:
+  CsvRecordWriter(const std::string &file_name,
+                  const std::vector<RecordColumn> &columns)
+      : _columns(columns) {
+    _file.open(file_name);
+    if (!_file.is_open())
+      throw std::runtime_error("Failed to open data file " + file_name + ".");
+
+    for (std::size_t i = 0; i < _columns.size(); ++i)
+      _file << _columns[i].name << (i + 1 < _columns.size() ? "," : "\n");
+  }
+
+  void write(const std::uint64_t *rows, std::size_t n) override {
+    const std::size_t width = _columns.size();
+    for (std::size_t r = 0; r < n; ++r) {
+      const std::uint64_t *row = rows + r * width;
+      for (std::size_t i = 0; i < width; ++i) {
+        if (_columns[i].type == ColumnType::INT64)
+          _file << unpackInt64(row[i]);
+        else
+          _file << unpackFloat64(row[i]);
+        _file << (i + 1 < width ? "," : "\n");
+      }
+    }
+  }
+
+  void close() override { _file.close(); }
+
+private:
+  std::vector<RecordColumn> _columns;
+  std::ofstream _file;
+};
+
+// Fixed-layout binary file. All values are little-endian.
+//
+//   offset  size  content
+//   0       8     magic "PYFRIREC"
+//   8       4     format version (uint32)
+//   12      4     number of columns C (uint32)
+//   16      32*C  column descriptors: char name[28] (zero padded), uint32 type
+//   16+32C  ...   samples, C 8-byte words each (int64 or float64)
+class BinaryRecordWriter : public RecordWriter {
+
+public:
+  static constexpr char MAGIC[8] = {'P', 'Y', 'F', 'R', 'I', 'R', 'E', 'C'};
+  static constexpr std::uint32_t VERSION = 1;
+  static constexpr std::size_t NAME_SIZE = 28;
+
+  BinaryRecordWriter(const std::string &file_name,
+                     const std::vector<RecordColumn> &columns)
+      : _width(columns.size()) {
+    _file.open(file_name, std::ios::binary);
+    if (!_file.is_open())
+      throw std::runtime_error("Failed to open data file " + file_name + ".");
+
+    const std::uint32_t version = VERSION;
+    const std::uint32_t num_columns = columns.size();
+    _file.write(MAGIC, sizeof(MAGIC));
+    _file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    _file.write(reinterpret_cast<const char *>(&num_columns),
+                sizeof(num_columns));
+
+    for (const RecordColumn &column : columns) {
+      if (column.name.size() >= NAME_SIZE)
+        throw std::runtime_error("Column name " + column.name +
+                                 " is too long.");
+      char name[NAME_SIZE] = {};
+      std::memcpy(name, column.name.data(), column.name.size());
+      const std::uint32_t type = static_cast<std::uint32_t>(column.type);
+      _file.write(name, sizeof(name));
+      _file.write(reinterpret_cast<const char *>(&type), sizeof(type));
+    }
+  }
+
+  void write(const std::uint64_t *rows, std::size_t n) override {
+    _file.write(reinterpret_cast<const char *>(rows),
+                n * _width * sizeof(std::uint64_t));
+  }
+
+  void close() override { _file.close(); }
+
+private:
+  std::size_t _width;
+  std::ofstream _file;
+};
+
+// Column-major binary file that numpy can memory-map directly, each column
+// is one contiguous run of 8-byte words. All values are little-endian.
+//
+//   offset   size  content
+//   0        8     magic "PYFRICOL"
+//   8        4     format version (uint32)
+//   12       4     number of columns C (uint32)
+//   16       8     number of samples N (uint64)
+//   24       8     column stride S in samples (uint64), S >= N
+//   32       8     offset D of the first column (uint64), page aligned
+//   40       24    reserved
+//   64       32*C  column descriptors: char name[28] (zero padded), uint32 type
+//   D+8*S*i  8*N   samples of column i (int64 or float64)
+//
+// Samples are staged in blocks of BLOCK_SIZE and written with one aligned
+// write per column. N and S are updated after every block, so the file stays
+// readable if the recorder is not stopped cleanly. Columns that outgrow
+// their capacity are moved apart to twice of it. On Linux file systems that
+// support it (e.g. ext4 and XFS) the space is inserted between the columns
+// without rewriting them, elsewhere the columns are copied, which takes as
+// long as writing the samples recorded so far and is absorbed by the
+// recorder's buffer. close() packs the columns to the smallest aligned
+// stride, once the recorder no longer waits for the writer.
+class ColumnarRecordWriter : public RecordWriter {
+
+public:
+  static constexpr char MAGIC[8] = {'P', 'Y', 'F', 'R', 'I', 'C', 'O', 'L'};
+  static constexpr std::uint32_t VERSION = 1;
+  static constexpr std::size_t NAME_SIZE = BinaryRecordWriter::NAME_SIZE;
+  static constexpr std::size_t HEADER_SIZE = 64;
+  static constexpr std::size_t ALIGNMENT = 4096;
+
+  // Samples per column and write (32 KiB)
+  static constexpr std::size_t BLOCK_SIZE = 4096;
+
+  // Initial capacity of the columns (about 65 s at 1 kHz, 512 KiB each)
+  static constexpr std::size_t INITIAL_STRIDE = 16 * BLOCK_SIZE;
+
+  ColumnarRecordWriter(const std::string &file_name,
+                       const std::vector<RecordColumn> &columns)
+      : _file_name(file_name), _width(columns.size()), _rows(0),
+        _stride(INITIAL_STRIDE), _staged(0),
+        _block(BLOCK_SIZE * columns.size()) {
+    _file.open(file_name, std::ios::in | std::ios::out | std::ios::binary |
+                              std::ios::trunc);
+    if (!_file.is_open())
+      throw std::runtime_error("Failed to open data file " + file_name + ".");
+
+    const std::size_t descriptor_size = NAME_SIZE + sizeof(std::uint32_t);
+    _data_offset = (HEADER_SIZE + descriptor_size * _width + ALIGNMENT - 1) /
+                   ALIGNMENT * ALIGNMENT;
+
+    std::vector<char> header(_data_offset, 0);
+    const std::uint32_t version = VERSION;
+    const std::uint32_t num_columns = _width;
+    std::memcpy(header.data(), MAGIC, sizeof(MAGIC));
+    std::memcpy(header.data() + 8, &version, sizeof(version));
+    std::memcpy(header.data() + 12, &num_columns, sizeof(num_columns));
+
+    for (std::size_t i = 0; i < _width; ++i) {
+      const RecordColumn &column = columns[i];
+      if (column.name.size() >= NAME_SIZE)
+        throw std::runtime_error("Column name " + column.name +
+                                 " is too long.");
+      char *descriptor = header.data() + HEADER_SIZE + i * descriptor_size;
+      const std::uint32_t type = static_cast<std::uint32_t>(column.type);
+      std::memcpy(descriptor, column.name.data(), column.name.size());
+      std::memcpy(descriptor + NAME_SIZE, &type, sizeof(type));
+    }
+    _file.write(header.data(), header.size());
+    _writeCounts();
+  }
+
+  void write(const std::uint64_t *rows, std::size_t n) override {
+    while (n > 0) {
+      const std::size_t count = std::min(n, BLOCK_SIZE - _staged);
+      for (std::size_t r = 0; r < count; ++r) {
+        const std::uint64_t *row = rows + r * _width;
+        for (std::size_t i = 0; i < _width; ++i)
+          _block[i * BLOCK_SIZE + _staged + r] = row[i];
+      }
+      _staged += count;
+      rows += count * _width;
+      n -= count;
+      if (_staged == BLOCK_SIZE)
+        _writeBlock();
+    }
+  }
+
+  void close() override {
+    if (!_file.is_open())
+      return;
+    if (_staged > 0)
+      _writeBlock();
+
+    // Pack the columns, each one moves towards the start of the file
+    const std::size_t words = ALIGNMENT / sizeof(std::uint64_t);
+    const std::size_t stride = (_rows + words - 1) / words * words;
+    for (std::size_t i = 1; i < _width; ++i)
+      _move(_offset(i, _stride), _offset(i, stride), _rows);
+    _stride = stride;
+    _writeCounts();
+    _file.close();
+
+    // Drop the unused capacity of the last column
+    std::filesystem::resize_file(_file_name, _offset(_width - 1, _stride) +
+                                                 _rows * sizeof(std::uint64_t));
+  }
+
+private:
+  std::string _file_name;
+  std::size_t _width;
+  std::size_t _rows;        // samples on disk
+  std::size_t _stride;      // capacity of each column in samples
+  std::size_t _staged;      // samples in _block
+  std::size_t _data_offset; // file offset of the first column
+  std::vector<std::uint64_t> _block; // BLOCK_SIZE samples per column
+  std::fstream _file;
+
+  std::size_t _offset(std::size_t column, std::size_t stride) const {
+    return _data_offset + column * stride * sizeof(std::uint64_t);
+  }
+
+  void _writeBlock() {
+    // The stride is a multiple of the block size, so one doubling suffices
+    if (_rows + _staged > _stride)
+      _grow();
+
+    for (std::size_t i = 0; i < _width; ++i) {
+      _file.seekp(_offset(i, _stride) + _rows * sizeof(std::uint64_t));
+      _file.write(reinterpret_cast<const char *>(_block.data() +
+                                                 i * BLOCK_SIZE),
+                  _staged * sizeof(std::uint64_t));
+    }
+    _rows += _staged;
+    _staged = 0;
+    _writeCounts();
+  }
+
+  void _grow() {
+    // Column i moves from i*S to 2*i*S. Inserting S words before every
+    // column from the first to the last shifts column i by i*S. If column k
+    // is the first one that could not be shifted, the columns from k on are
+    // (k - 1)*S further and copied from the last to the first, so every
+    // destination only overlaps columns that already moved.
+    const std::size_t stride = 2 * _stride;
+    const std::size_t shifted = _insertSpace(_stride);
+    for (std::size_t i = _width; i-- > shifted + 1;)
+      _move(_offset(i + shifted, _stride), _offset(i, stride), _rows);
+    _stride = stride;
+  }
+
+  // Insert words of space before the columns from the second one on,
+  // returns how many columns were shifted
+  std::size_t _insertSpace(std::size_t words) {
+    std::size_t shifted = 0;
+#if defined(__linux__) && defined(FALLOC_FL_INSERT_RANGE)
+    _file.flush();
+    const int fd = ::open(_file_name.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+      return 0;
+    // Column i is at (i + shifted)*S
+    while (shifted + 1 < _width &&
+           ::fallocate(fd, FALLOC_FL_INSERT_RANGE,
+                       _offset(2 * shifted + 1, words),
+                       words * sizeof(std::uint64_t)) == 0)
+      ++shifted;
+    ::close(fd);
+#endif
+    return shifted;
+  }
+
+  // Copy words from one file offset to another in chunks from the start,
+  // which is safe for overlapping ranges as long as to <= from or the ranges
+  // are disjoint.
+  void _move(std::size_t from, std::size_t to, std::size_t words) {
+    if (from == to)
+      return;
+    std::vector<char> chunk(1 << 20);
+    std::size_t remaining = words * sizeof(std::uint64_t);
+    while (remaining > 0) {
+      const std::size_t n = std::min(remaining, chunk.size());
+      _file.seekg(from);
+      _file.read(chunk.data(), n);
+      _file.seekp(to);
+      _file.write(chunk.data(), n);
+      from += n;
+      to += n;
+      remaining -= n;
+    }
+  }
+
+  void _writeCounts() {
+    const std::uint64_t counts[3] = {_rows, _stride, _data_offset};
+    _file.seekp(16);
+    _file.write(reinterpret_cast<const char *>(counts), sizeof(counts));
+    _file.flush();
+  }
+};
+
+// Convert a binary or columnar recording to the CSV layout written by the
+// recorder in CSV mode.
+inline void convertRecordingToCsv(const std::string &binary_file_name,
+                                  const std::string &csv_file_name) {
+
+  std::ifstream file(binary_file_name, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("Failed to open data file " + binary_file_name +
+                             ".");
+
+  // Read header
+  char magic[sizeof(BinaryRecordWriter::MAGIC)] = {};
+  std::uint32_t version = 0, num_columns = 0;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char *>(&version), sizeof(version));
+  file.read(reinterpret_cast<char *>(&num_columns), sizeof(num_columns));
+  const bool columnar = std::memcmp(magic, ColumnarRecordWriter::MAGIC,
+                                    sizeof(magic)) == 0;
+  if (!file || num_columns == 0 ||
+      (!columnar &&
+       std::memcmp(magic, BinaryRecordWriter::MAGIC, sizeof(magic)) != 0))
+    throw std::runtime_error(binary_file_name +
+                             " is not a pyfri binary recording.");
+  if (version != (columnar ? ColumnarRecordWriter::VERSION
+                           : BinaryRecordWriter::VERSION))
+    throw std::runtime_error("Unsupported recording version " +
+                             std::to_string(version) + ".");
+
+  // Number of samples, column stride and offset of the columnar layout
+  std::uint64_t counts[3] = {};
+  if (columnar) {
+    file.read(reinterpret_cast<char *>(counts), sizeof(counts));
+    file.seekg(ColumnarRecordWriter::HEADER_SIZE);
+  }
+
+  std::vector<RecordColumn> columns(num_columns);
+  for (RecordColumn &column : columns) {
+    char name[BinaryRecordWriter::NAME_SIZE + 1] = {};
+    std::uint32_t type = 0;
+    file.read(name, BinaryRecordWriter::NAME_SIZE);
+    file.read(reinterpret_cast<char *>(&type), sizeof(type));
+    column.name = name;
+    column.type = static_cast<ColumnType>(type);
+  }
+  if (!file)
+    throw std::runtime_error("Truncated header in " + binary_file_name + ".");
+
+  // Convert samples in chunks
+  CsvRecordWriter writer(csv_file_name, columns);
+  const std::size_t chunk = 4096;
+  std::vector<std::uint64_t> rows(chunk * num_columns);
+  if (columnar) {
+    const std::uint64_t num_rows = counts[0], stride = counts[1];
+    std::vector<std::uint64_t> values(chunk);
+    for (std::uint64_t first = 0; first < num_rows; first += chunk) {
+      const std::size_t n = std::min<std::uint64_t>(chunk, num_rows - first);
+      for (std::size_t i = 0; i < num_columns; ++i) {
+        file.seekg(counts[2] + (i * stride + first) * sizeof(std::uint64_t));
+        file.read(reinterpret_cast<char *>(values.data()),
+                  n * sizeof(std::uint64_t));
+        for (std::size_t r = 0; r < n; ++r)
+          rows[r * num_columns + i] = values[r];
+      }
+      if (!file)
+        throw std::runtime_error("Truncated data in " + binary_file_name +
+                                 ".");
+      writer.write(rows.data(), n);
+    }
+  } else {
+    while (file) {
+      file.read(reinterpret_cast<char *>(rows.data()),
+                rows.size() * sizeof(std::uint64_t));
+      const std::size_t n =
+          file.gcount() / (num_columns * sizeof(std::uint64_t));
+      writer.write(rows.data(), n);
+    }
+  }
+  writer.close();
+}
+
+// Records robot state samples from the FRI thread. A sample is copied into a
+// preallocated ring buffer and a background thread drains the buffer to disk,
+// so that no formatting or file I/O happens while the controller waits for
+// the command.
+class DataRecorder {
+
+public:
+  // Number of samples that can be buffered (about 16 s at 1 kHz)
+  static constexpr std::size_t BUFFER_CAPACITY = 1 << 14;
+
+  // How often the background thread drains the buffer
+  static constexpr std::chrono::milliseconds DRAIN_PERIOD{5};
+
+  DataRecorder()
+      : _recording(false), _running(false), _io_checked(false),
+        _decimation(1), _dropped(0),
+        _index(0), _time(0.0) {}
+
+  ~DataRecorder() { stop(); }
+
+  bool is_recording() const { return _recording; }
+
+  const std::string &file_name() const { return _file_name; }
+
+  unsigned long long dropped_samples() const { return _dropped; }
+
+  // Record the given signals of every decimation-th sample
+  void start(std::string file_name, RecordingFormat format,
+             const std::vector<std::string> &signals = defaultRecordSignals(),
+             unsigned int decimation = 1) {
+
+    // Ensure file name ends with the extension of the format
+    std::string extension = format == RecordingFormat::CSV      ? ".csv"
+                            : format == RecordingFormat::BINARY ? ".bin"
+                                                                : ".col";
+
+    if (file_name.length() < extension.length() ||
+        file_name.compare(file_name.length() - extension.length(),
+                          extension.length(), extension) != 0) {
+      // File name doesn't end with the extension, so append it.
+      file_name += extension;
+    }
+
+    start(
+        [&](const std::vector<RecordColumn> &columns)
+            -> std::unique_ptr<RecordWriter> {
+          if (format == RecordingFormat::CSV)
+            return std::make_unique<CsvRecordWriter>(file_name, columns);
+          if (format == RecordingFormat::BINARY)
+            return std::make_unique<BinaryRecordWriter>(file_name, columns);
+          return std::make_unique<ColumnarRecordWriter>(file_name, columns);
+        },
+        signals, decimation);
+    _file_name = file_name;
+  }
+
+  // Record into the writer that make_writer creates for the columns, e.g. to
+  // stream the samples instead of writing a file
+  void start(const std::function<std::unique_ptr<RecordWriter>(
+                 const std::vector<RecordColumn> &columns)> &make_writer,
+             const std::vector<std::string> &signals = defaultRecordSignals(),
+             unsigned int decimation = 1) {
+
+    stop();
+
+    if (decimation == 0)
+      throw std::runtime_error("decimation must be positive!");
+    _signals = recordSignals(signals);
+    _io_checked = false;
+    _decimation = decimation;
+    _columns = recordColumns(_signals);
+    _writer = make_writer(_columns);
+
+    _file_name.clear();
+    _buffer = std::make_unique<RingBuffer>(BUFFER_CAPACITY, _columns.size());
+    _index = 0;
+    _time = 0.0;
+    _dropped = 0;
+
+    _running = true;
+    _thread = std::thread(&DataRecorder::_drain, this);
+    _recording = true;
+  }
+
+  // The writer while recording, nullptr otherwise
+  const RecordWriter *writer() const { return _writer.get(); }
+
+  // Called from the FRI thread after each step
+  void record(const KUKA::FRI::LBRState &state,
+              const PacketTimestamps &packet) {
+
+    // A recording with an unknown IO stops at its first sample
+    if (!_io_checked) {
+      try {
+        checkRecordIO(state, _signals);
+      } catch (...) {
+        stop();
+        throw;
+      }
+      _io_checked = true;
+    }
+
+    if (_index % _decimation == 0) {
+      std::uint64_t *row = _buffer->claim();
+      if (row) {
+        row[0] = packInt64(_index);
+        row[1] = packFloat64(_time);
+        row[2] = packInt64(getCurrentTimeInNanoseconds());
+        row[3] = packInt64(state.getTimestampSec());
+        row[4] = packInt64(state.getTimestampNanoSec());
+        std::uint64_t *words = row + 5;
+        for (const RecordSignal &signal : _signals) {
+          if (signal.packet_copy)
+            signal.packet_copy(packet, words);
+          else
+            signal.copy(state, signal.io, words);
+          words += signal.columns.size();
+        }
+        _buffer->commit();
+      } else {
+        // Writer fell behind, drop the sample rather than block
+        _dropped++;
+      }
+    }
+
+    // Increment _index and _time
+    _index++;
+    _time += state.getSampleTime();
+  }
+
+  void stop() {
+    if (!_recording)
+      return;
+
+    _running = false;
+    _thread.join();
+    _writer->close();
+    _writer.reset();
+    _recording = false;
+  }
+
+private:
+  bool _recording;
+  std::atomic<bool> _running;
+  std::string _file_name;
+  std::vector<RecordSignal> _signals;
+  bool _io_checked; // against the state of the first sample
+  unsigned int _decimation;
+  std::vector<RecordColumn> _columns;
+  std::unique_ptr<RecordWriter> _writer;
+  std::unique_ptr<RingBuffer> _buffer;
+  std::thread _thread;
+  std::atomic<unsigned long long> _dropped;
+  long long _index;
+  long double _time;
+
+  void _flush() {
+    std::size_t n;
+    while ((n = _buffer->available()) > 0) {
+      n = _buffer->contiguous(n);
+      _writer->write(_buffer->peek(0), n);
+      _buffer->release(n);
+    }
+  }
+
+  void _drain() {
+    while (_running) {
+      _flush();
+      std::this_thread::sleep_for(DRAIN_PERIOD);
+    }
+    _flush();
+  }
+};
+
+#endif // PYFRI_DATA_RECORDER_H
@@ -0,0 +1,102 @@
+#ifndef PYFRI_EVENT_POLLER_H
+#define PYFRI_EVENT_POLLER_H
+
+// Standard library
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+// Waits until any of a set of file descriptors is readable, using epoll.
+// Every descriptor is registered with a key that is reported back when it
+// becomes ready.
+class EventPoller {
+
+public:
+  EventPoller() : _epoll(-1) {
+#ifdef __linux__
+    _epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll < 0)
+      throw std::runtime_error(std::string("epoll_create1 failed: ") +
+                               std::strerror(errno));
+#else
+    throw std::runtime_error("EventPoller is only supported on Linux.");
+#endif
+  }
+
+  ~EventPoller() {
+#ifdef __linux__
+    if (_epoll >= 0)
+      ::close(_epoll);
+#endif
+  }
+
+  EventPoller(const EventPoller &) = delete;
+  EventPoller &operator=(const EventPoller &) = delete;
+
+  void add(int fd, std::size_t key) {
+#ifdef __linux__
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = key;
+    if (::epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event) < 0)
+      throw std::runtime_error(std::string("epoll_ctl failed: ") +
+                               std::strerror(errno));
+    _events.resize(_events.size() + 1);
+#endif
+  }
+
+  // A closed descriptor is dropped by the kernel, so errors are ignored
+  void remove(int fd) {
+#ifdef __linux__
+    epoll_event event = {};
+    ::epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, &event);
+    if (!_events.empty())
+      _events.pop_back();
+#endif
+  }
+
+  // Forget a registration the kernel already dropped, i.e. of a descriptor
+  // that was closed and whose number may now belong to another socket
+  void release() {
+#ifdef __linux__
+    if (!_events.empty())
+      _events.pop_back();
+#endif
+  }
+
+  // Wait at most timeout_ms (< 0 waits indefinitely) until at least one
+  // descriptor is readable. The keys of the ready descriptors are stored in
+  // `ready`, which is empty on timeout.
+  void wait(int timeout_ms, std::vector<std::size_t> &ready) {
+    ready.clear();
+#ifdef __linux__
+    if (_events.empty())
+      return;
+    int n;
+    do
+      n = ::epoll_wait(_epoll, _events.data(), _events.size(), timeout_ms);
+    while (n < 0 && errno == EINTR);
+    if (n < 0)
+      throw std::runtime_error(std::string("epoll_wait failed: ") +
+                               std::strerror(errno));
+    for (int i = 0; i < n; ++i)
+      ready.push_back(_events[i].data.u64);
+#endif
+  }
+
+private:
+  int _epoll;
+#ifdef __linux__
+  std::vector<epoll_event> _events; // one per registered descriptor
+#endif
+};
+
+#endif // PYFRI_EVENT_POLLER_H
@@ -0,0 +1,333 @@
+"""Generate header-only forward kinematics and Jacobian kernels.
+
+Run at build time by CMake, e.g.
+
+    python generate_kinematics.py -o generated_kinematics.h med7.urdf.xacro
+
+For every robot description the kinematic chain from the root link to the
+tip link is unrolled into straight-line C++ with the joint origins and axes as
+literals, so the compiler can fold all constants. Only the subset of xacro
+used by the bundled robot descriptions is supported: properties, includes,
+macros with default parameters and ${} expressions.
+"""
+
+import argparse
+import math
+import os
+import re
+import xml.etree.ElementTree as ET
+
+XACRO_NS = "http://www.ros.org/wiki/xacro"
+XACRO = "{" + XACRO_NS + "}"
+EXPRESSION = re.compile(r"\$\{([^}]*)\}")
+
+
+class Xacro:
+    def __init__(self):
+        self.properties = {"pi": math.pi}
+        self.macros = {}
+
+    def substitute(self, text, names):
+        def evaluate(match):
+            value = eval(match.group(1), {"__builtins__": {}}, names)
+            return str(value)
+
+        return EXPRESSION.sub(evaluate, text)
+
+    def load(self, file_name):
+        root = ET.parse(file_name).getroot()
+        directory = os.path.dirname(file_name)
+        for element in list(root):
+            if element.tag == XACRO + "property":
+                self.properties[element.get("name")] = self._value(
+                    self.substitute(element.get("value"), self.properties)
+                )
+            elif element.tag == XACRO + "include":
+                self.load(os.path.join(directory, element.get("filename")))
+            elif element.tag == XACRO + "macro":
+                self.macros[element.get("name")] = element
+        return root
+
+    def expand(self, file_name):
+        """Return the joints of the robot as a list of dictionaries."""
+        root = self.load(file_name)
+        joints = []
+        self._expand(root, dict(self.properties), joints)
+        return root.get("name"), joints
+
+    def _expand(self, element, names, joints):
+        for child in list(element):
+            if child.tag.startswith(XACRO):
+                name = child.tag[len(XACRO) :]
+                if name in self.macros:
+                    self._expand(
+                        self.macros[name], self._arguments(name, child, names), joints
+                    )
+            elif child.tag == "joint":
+                joints.append(self._joint(child, names))
+
+    def _arguments(self, name, call, names):
+        arguments = dict(self.properties)
+        for parameter in self.macros[name].get("params", "").split():
+            key, _, default = parameter.partition(":=")
+            default = default.split("|")[-1] if "|" in default else default
+            arguments[key] = default
+        for key, value in call.attrib.items():
+            arguments[key] = self.substitute(value, names)
+        return arguments
+
+    def _joint(self, element, names):
+        def attribute(tag, key, default):
+            child = element.find(tag)
+            if child is None or child.get(key) is None:
+                return default
+            return [
+                float(v) for v in self.substitute(child.get(key), names).split()
+            ]
+
+        return {
+            "name": self.substitute(element.get("name"), names),
+            "type": element.get("type"),
+            "parent": self.substitute(element.find("parent").get("link"), names),
+            "child": self.substitute(element.find("child").get("link"), names),
+            "xyz": attribute("origin", "xyz", [0.0, 0.0, 0.0]),
+            "rpy": attribute("origin", "rpy", [0.0, 0.0, 0.0]),
+            "axis": attribute("axis", "xyz", [1.0, 0.0, 0.0]),
+        }
+
+    @staticmethod
+    def _value(text):
+        try:
+            return float(text)
+        except ValueError:
+            return text
+
+
+def chain(joints, tip):
+    """Joints from the root link to the tip link."""
+    by_child = {joint["child"]: joint for joint in joints}
+    result = []
+    link = tip
+    while link in by_child:
+        joint = by_child[link]
+        result.insert(0, joint)
+        link = joint["parent"]
+    if not result:
+        raise ValueError(f"Link {tip} is not part of the robot")
+    return result
+
+
+def rpy_matrix(rpy):
+    r, p, y = rpy
+    cr, sr = math.cos(r), math.sin(r)
+    cp, sp = math.cos(p), math.sin(p)
+    cy, sy = math.cos(y), math.sin(y)
+    return [
+        [cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr],
+        [sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr],
+        [-sp, cp * sr, cp * cr],
+    ]
+
+
+def literal(value):
+    return repr(float(value))
+
+
+class Emitter:
+    """Straight-line code for R (r<row><column>) and p (p<row>)."""
+
+    def __init__(self):
+        self.lines = []
+        self.counter = 0
+
+    def emit(self, line):
+        self.lines.append("    " + line)
+
+    def translate(self, xyz):
+        # p += R * xyz
+        for i in range(3):
+            terms = [
+                f"r{i}{k} * {literal(xyz[k])}" for k in range(3) if xyz[k] != 0.0
+            ]
+            if terms:
+                self.emit(f"p{i} += {' + '.join(terms)};")
+
+    def rotate_constant(self, matrix):
+        # R = R * matrix
+        if all(
+            abs(matrix[i][j] - (1.0 if i == j else 0.0)) < 1e-15
+            for i in range(3)
+            for j in range(3)
+        ):
+            return
+        self.counter += 1
+        n = self.counter
+        for i in range(3):
+            for j in range(3):
+                terms = [
+                    f"r{i}{k} * {literal(matrix[k][j])}"
+                    for k in range(3)
+                    if abs(matrix[k][j]) > 1e-15
+                ]
+                self.emit(f"const double t{n}_{i}{j} = {' + '.join(terms) or '0.0'};")
+        for i in range(3):
+            for j in range(3):
+                self.emit(f"r{i}{j} = t{n}_{i}{j};")
+
+    def rotate_joint(self, axis, index):
+        # R = R * rotation(axis, q[index]) for a principal axis
+        principal = [k for k in range(3) if axis[k] != 0.0]
+        if len(principal) != 1 or abs(abs(axis[principal[0]]) - 1.0) > 1e-12:
+            raise NotImplementedError("Only joint axes along x, y or z are supported")
+        k = principal[0]
+        sign = "" if axis[k] > 0.0 else "-"
+        a, b = [(1, 2), (2, 0), (0, 1)][k]  # columns rotated by the joint
+        self.emit(f"const double c{index} = std::cos(q[{index}]);")
+        self.emit(f"const double s{index} = {sign}std::sin(q[{index}]);")
+        for i in range(3):
+            self.emit(
+                f"const double a{index}_{i} = r{i}{a} * c{index} + r{i}{b} * s{index};"
+            )
+            self.emit(f"r{i}{b} = r{i}{b} * c{index} - r{i}{a} * s{index};")
+            self.emit(f"r{i}{a} = a{index}_{i};")
+        return k, axis[k]
+
+
+def generate(robot, joints, tip):
+    joints = chain(joints, tip)
+    revolute = [j for j in joints if j["type"] in ("revolute", "continuous")]
+    n = len(revolute)
+    name = robot[0].upper() + robot[1:]
+
+    emitter = Emitter()
+    axes = []
+    for joint in joints:
+        emitter.translate(joint["xyz"])
+        emitter.rotate_constant(rpy_matrix(joint["rpy"]))
+        if joint["type"] in ("revolute", "continuous"):
+            # Joint origin and axis in the base frame, the axis does not
+            # change with the joint's own rotation
+            index = len(axes)
+            k, direction = emitter.rotate_joint(joint["axis"], index)
+            sign = "" if direction > 0.0 else "-"
+            for i in range(3):
+                emitter.emit(f"o[{index}][{i}] = p{i};")
+                emitter.emit(f"z[{index}][{i}] = {sign}r{i}{k};")
+            axes.append(joint)
+        elif joint["type"] != "fixed":
+            raise NotImplementedError(f"Joint type {joint['type']} is not supported")
+    for i in range(3):
+        for j in range(3):
+            emitter.emit(f"transform[{4 * i + j}] = r{i}{j};")
+        emitter.emit(f"transform[{4 * i + 3}] = p{i};")
+    for j in range(3):
+        emitter.emit(f"transform[{12 + j}] = 0.0;")
+    emitter.emit("transform[15] = 1.0;")
+    body = "\n".join(emitter.lines)
+
+    names = "".join(f'\n        "{j["name"]}",' for j in revolute)
+    return f"""// Forward kinematics of {robot}, from {joints[0]["parent"]} to {tip}
+struct {name}Kinematics {{
+  static constexpr unsigned int NUMBER_OF_JOINTS = {n};
+
+  static constexpr const char *NAME = "{robot}";
+  static constexpr const char *BASE_LINK = "{joints[0]["parent"]}";
+  static constexpr const char *TIP_LINK = "{tip}";
+
+  // Tip pose as a row-major 4x4 homogeneous transform
+  static void forward_kinematics(const double *q, double *transform) {{
+    double o[NUMBER_OF_JOINTS][3], z[NUMBER_OF_JOINTS][3];
+    _chain(q, transform, o, z);
+  }}
+
+  // Geometric Jacobian of the tip in the base frame, row-major 6 x
+  // NUMBER_OF_JOINTS with the linear velocity in the first three rows
+  static void jacobian(const double *q, double *jacobian) {{
+    double transform[16];
+    double o[NUMBER_OF_JOINTS][3], z[NUMBER_OF_JOINTS][3];
+    _chain(q, transform, o, z);
+    _jacobian(transform, o, z, jacobian);
+  }}
+
+  // Both at the cost of one pass along the chain
+  static void forward_kinematics_and_jacobian(const double *q,
+                                              double *transform,
+                                              double *jacobian) {{
+    double o[NUMBER_OF_JOINTS][3], z[NUMBER_OF_JOINTS][3];
+    _chain(q, transform, o, z);
+    _jacobian(transform, o, z, jacobian);
+  }}
+
+  static const char *joint_name(unsigned int i) {{
+    static const char *const names[NUMBER_OF_JOINTS] = {{{names}
+    }};
+    return names[i];
+  }}
+
+private:
+  static void _chain(const double *q, double *transform,
+                     double o[NUMBER_OF_JOINTS][3],
+                     double z[NUMBER_OF_JOINTS][3]) {{
+    double r00 = 1.0, r01 = 0.0, r02 = 0.0;
+    double r10 = 0.0, r11 = 1.0, r12 = 0.0;
+    double r20 = 0.0, r21 = 0.0, r22 = 1.0;
+    double p0 = 0.0, p1 = 0.0, p2 = 0.0;
+{body}
+  }}
+
+  static void _jacobian(const double *transform,
+                        const double o[NUMBER_OF_JOINTS][3],
+                        const double z[NUMBER_OF_JOINTS][3],
+                        double *jacobian) {{
+    const double p[3] = {{transform[3], transform[7], transform[11]}};
+    for (unsigned int i = 0; i < NUMBER_OF_JOINTS; ++i) {{
+      const double d[3] = {{p[0] - o[i][0], p[1] - o[i][1], p[2] - o[i][2]}};
+      jacobian[0 * NUMBER_OF_JOINTS + i] = z[i][1] * d[2] - z[i][2] * d[1];
+      jacobian[1 * NUMBER_OF_JOINTS + i] = z[i][2] * d[0] - z[i][0] * d[2];
+      jacobian[2 * NUMBER_OF_JOINTS + i] = z[i][0] * d[1] - z[i][1] * d[0];
+      jacobian[3 * NUMBER_OF_JOINTS + i] = z[i][0];
+      jacobian[4 * NUMBER_OF_JOINTS + i] = z[i][1];
+      jacobian[5 * NUMBER_OF_JOINTS + i] = z[i][2];
+    }}
+  }}
+}};
+"""
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("xacro", nargs="+", help="robot descriptions")
+    parser.add_argument("-o", "--output", required=True, help="header to write")
+    parser.add_argument("--tip", default="lbr_link_ee", help="tip link")
+    args = parser.parse_args()
+
+    kernels = []
+    for file_name in args.xacro:
+        robot, joints = Xacro().expand(file_name)
+        kernels.append(generate(robot, joints, args.tip))
+
+    header = "\n".join(
+        [
+            "// Generated by generate_kinematics.py, do not edit.",
+            "#ifndef PYFRI_GENERATED_KINEMATICS_H",
+            "#define PYFRI_GENERATED_KINEMATICS_H",
+            "",
+            "// Standard library",
+            "#include <cmath>",
+            "",
+        ]
+        + kernels
+        + ["#endif // PYFRI_GENERATED_KINEMATICS_H", ""]
+    )
+
+    # Only touch the header if it changed, to avoid needless rebuilds
+    if os.path.exists(args.output):
+        with open(args.output) as f:
+            if f.read() == header:
+                return
+    with open(args.output, "w") as f:
+        f.write(header)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,289 @@
+#ifndef PYFRI_JOINT_STATE_ESTIMATOR_H
+#define PYFRI_JOINT_STATE_ESTIMATOR_H
+
+// Standard library
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friLBRState.h"
+
+#include "native_controllers.h"
+
+enum class EstimationMethod {
+  FINITE_DIFFERENCE, // backward differences of the last three samples
+  SAVITZKY_GOLAY,    // polynomial least-squares fit over a window
+  KALMAN             // constant-acceleration Kalman filter
+};
+
+// Native counterpart of pyfri.tools.state_estimators.JointStateEstimator.
+// Attached to an LBRClient it is updated inside step() from the measured
+// joint position of every state packet, before the client callbacks run.
+// The last `history` estimates are kept in fixed rings.
+class JointStateEstimator {
+
+public:
+  static constexpr unsigned int N = KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+
+  JointStateEstimator(
+      EstimationMethod method = EstimationMethod::FINITE_DIFFERENCE,
+      std::size_t window = 7, unsigned int polynomial_order = 2,
+      double process_noise = 1e4, double measurement_noise = 1e-10,
+      std::size_t history = 3)
+      : _method(method), _window(window), _polynomial_order(polynomial_order),
+        _process_noise(process_noise), _measurement_noise(measurement_noise),
+        _history(std::max<std::size_t>(history, 2)) {
+    if (method == EstimationMethod::SAVITZKY_GOLAY) {
+      if (polynomial_order < 2 || polynomial_order > 6 ||
+          window <= polynomial_order)
+        throw std::runtime_error("Savitzky-Golay requires 2 <= "
+                                 "polynomial_order <= 6 and window > "
+                                 "polynomial_order!");
+      _savitzkyGolayWeights();
+    }
+    if (method == EstimationMethod::KALMAN &&
+        !(process_noise > 0.0 && measurement_noise > 0.0))
+      throw std::runtime_error("Kalman noise parameters must be positive!");
+
+    // Positions needed for the differentiation
+    const std::size_t depth =
+        method == EstimationMethod::SAVITZKY_GOLAY ? window : 3;
+    _samples.resize(std::max(depth, _history));
+    _dq.resize(_history);
+    _ddq.resize(_history);
+    reset();
+  }
+
+  EstimationMethod method() const { return _method; }
+
+  std::size_t window() const { return _window; }
+
+  unsigned int polynomial_order() const { return _polynomial_order; }
+
+  std::size_t history() const { return _history; }
+
+  // Forget all samples, the next one restarts the estimate at rest
+  void reset() { _count = 0; }
+
+  // Number of samples since construction or reset()
+  std::size_t count() const { return _count; }
+
+  void update(const KUKA::FRI::LBRState &state) {
+    update(state.getMeasuredJointPosition(), state.getSampleTime());
+  }
+
+  // Update from N joint positions measured dt seconds after the last ones,
+  // e.g. those of a recording
+  void update(const double *q, double dt) {
+    const std::size_t n = _count++;
+
+    if (n == 0) {
+      // Start at rest, as if the robot stood still before the first sample
+      for (JointArray &sample : _samples)
+        std::copy(q, q + N, sample.begin());
+      for (std::size_t i = 0; i < _history; ++i) {
+        _dq[i].fill(0.0);
+        _ddq[i].fill(0.0);
+      }
+      _kalmanReset(q);
+      return;
+    }
+
+    const std::size_t samples = _samples.size();
+    std::copy(q, q + N, _samples[n % samples].begin());
+    JointArray &dq = _dq[n % _history];
+    JointArray &ddq = _ddq[n % _history];
+
+    switch (_method) {
+    case EstimationMethod::FINITE_DIFFERENCE: {
+      const JointArray &q1 = _samples[(n - 1) % samples];
+      const JointArray &dq1 = _dq[(n - 1) % _history];
+      for (unsigned int i = 0; i < N; ++i) {
+        dq[i] = (q[i] - q1[i]) / dt;
+        ddq[i] = (dq[i] - dq1[i]) / dt;
+      }
+      break;
+    }
+    case EstimationMethod::SAVITZKY_GOLAY: {
+      dq.fill(0.0);
+      ddq.fill(0.0);
+      for (std::size_t k = 0; k < _window; ++k) {
+        // Before the window is full the ring still holds the first sample
+        const JointArray &qk = _samples[(n + samples - k) % samples];
+        const double w1 = _velocity_weights[k] / dt;
+        const double w2 = _acceleration_weights[k] / (dt * dt);
+        for (unsigned int i = 0; i < N; ++i) {
+          dq[i] += w1 * qk[i];
+          ddq[i] += w2 * qk[i];
+        }
+      }
+      break;
+    }
+    case EstimationMethod::KALMAN:
+      _kalmanUpdate(q, dt, dq, ddq);
+      break;
+    }
+  }
+
+  // Estimates of the past samples, index -1 is the latest, -history the
+  // oldest one kept
+  const JointArray &position(long index) const {
+    return _samples[_sample(index) % _samples.size()];
+  }
+
+  const JointArray &velocity(long index) const {
+    return _dq[_sample(index) % _history];
+  }
+
+  const JointArray &acceleration(long index) const {
+    return _ddq[_sample(index) % _history];
+  }
+
+private:
+  EstimationMethod _method;
+  std::size_t _window;
+  unsigned int _polynomial_order;
+  double _process_noise;     // jerk spectral density, (rad/s^3)^2/Hz
+  double _measurement_noise; // position variance, rad^2
+  std::size_t _history;
+
+  std::vector<JointArray> _samples; // ring of measured positions
+  std::vector<JointArray> _dq;      // ring of velocity estimates
+  std::vector<JointArray> _ddq;     // ring of acceleration estimates
+  std::size_t _count;               // sample n is kept in slot n % size
+
+  // Savitzky-Golay weights of the k-th latest sample, in sample units
+  std::vector<double> _velocity_weights;
+  std::vector<double> _acceleration_weights;
+
+  // Kalman state per joint, the covariance and gain are the same for all
+  // joints since they share the model and the measurement times
+  JointArray _x[3];
+  double _p[3][3];
+
+  // Number of the sample `index` steps back
+  std::size_t _sample(long index) const {
+    if (_count == 0)
+      throw std::runtime_error("No state has been estimated yet.");
+    if (index >= 0 || -index > static_cast<long>(_history))
+      throw std::out_of_range("Index " + std::to_string(index) +
+                              " is outside of the estimator history.");
+    // Before the history is full the older slots hold the first sample
+    const std::size_t back = static_cast<std::size_t>(-index);
+    return back <= _count ? _count - back : 0;
+  }
+
+  void _savitzkyGolayWeights() {
+    // Least-squares fit of q(s) = sum c_j s^j to the samples at s = -k,
+    // k = 0 .. window - 1. The weights are rows 1 and 2 of
+    // (V^T V)^-1 V^T, scaled by j! for the derivatives at s = 0.
+    const unsigned int m = _polynomial_order + 1;
+    std::vector<double> a(m * m, 0.0);
+    for (unsigned int r = 0; r < m; ++r)
+      for (unsigned int c = 0; c < m; ++c)
+        for (std::size_t k = 0; k < _window; ++k)
+          a[r * m + c] += std::pow(-static_cast<double>(k), r + c);
+
+    // Invert V^T V by Gauss-Jordan elimination with partial pivoting
+    std::vector<double> inverse(m * m, 0.0);
+    for (unsigned int r = 0; r < m; ++r)
+      inverse[r * m + r] = 1.0;
+    for (unsigned int c = 0; c < m; ++c) {
+      unsigned int pivot = c;
+      for (unsigned int r = c + 1; r < m; ++r)
+        if (std::abs(a[r * m + c]) > std::abs(a[pivot * m + c]))
+          pivot = r;
+      for (unsigned int j = 0; j < m; ++j) {
+        std::swap(a[c * m + j], a[pivot * m + j]);
+        std::swap(inverse[c * m + j], inverse[pivot * m + j]);
+      }
+      const double scale = 1.0 / a[c * m + c];
+      for (unsigned int j = 0; j < m; ++j) {
+        a[c * m + j] *= scale;
+        inverse[c * m + j] *= scale;
+      }
+      for (unsigned int r = 0; r < m; ++r) {
+        if (r == c)
+          continue;
+        const double factor = a[r * m + c];
+        for (unsigned int j = 0; j < m; ++j) {
+          a[r * m + j] -= factor * a[c * m + j];
+          inverse[r * m + j] -= factor * inverse[c * m + j];
+        }
+      }
+    }
+
+    _velocity_weights.assign(_window, 0.0);
+    _acceleration_weights.assign(_window, 0.0);
+    for (std::size_t k = 0; k < _window; ++k) {
+      for (unsigned int j = 0; j < m; ++j) {
+        const double v = std::pow(-static_cast<double>(k), j);
+        _velocity_weights[k] += inverse[1 * m + j] * v;
+        _acceleration_weights[k] += 2.0 * inverse[2 * m + j] * v;
+      }
+    }
+  }
+
+  void _kalmanReset(const double *q) {
+    std::copy(q, q + N, _x[0].begin());
+    _x[1].fill(0.0);
+    _x[2].fill(0.0);
+    for (unsigned int r = 0; r < 3; ++r)
+      for (unsigned int c = 0; c < 3; ++c)
+        _p[r][c] = 0.0;
+    _p[0][0] = _measurement_noise;
+    _p[1][1] = 1.0;
+    _p[2][2] = 1.0e2;
+  }
+
+  void _kalmanUpdate(const double *q, double dt, JointArray &dq,
+                     JointArray &ddq) {
+    // Predict the covariance, P = F P F^T + Q with
+    // F = [1 dt dt^2/2; 0 1 dt; 0 0 1] and white-jerk process noise
+    const double f[3][3] = {
+        {1.0, dt, 0.5 * dt * dt}, {0.0, 1.0, dt}, {0.0, 0.0, 1.0}};
+    const double dt2 = dt * dt, dt3 = dt2 * dt;
+    const double s = _process_noise;
+    const double q_noise[3][3] = {
+        {s * dt3 * dt2 / 20.0, s * dt2 * dt2 / 8.0, s * dt3 / 6.0},
+        {s * dt2 * dt2 / 8.0, s * dt3 / 3.0, s * dt2 / 2.0},
+        {s * dt3 / 6.0, s * dt2 / 2.0, s * dt}};
+    double fp[3][3];
+    for (unsigned int r = 0; r < 3; ++r)
+      for (unsigned int c = 0; c < 3; ++c)
+        fp[r][c] = f[r][0] * _p[0][c] + f[r][1] * _p[1][c] + f[r][2] * _p[2][c];
+    double p[3][3];
+    for (unsigned int r = 0; r < 3; ++r)
+      for (unsigned int c = 0; c < 3; ++c)
+        p[r][c] = fp[r][0] * f[c][0] + fp[r][1] * f[c][1] + fp[r][2] * f[c][2] +
+                  q_noise[r][c];
+
+    // Gain for the position measurement, H = [1 0 0]
+    const double innovation_variance = p[0][0] + _measurement_noise;
+    const double k[3] = {p[0][0] / innovation_variance,
+                         p[1][0] / innovation_variance,
+                         p[2][0] / innovation_variance};
+    for (unsigned int r = 0; r < 3; ++r)
+      for (unsigned int c = 0; c < 3; ++c)
+        _p[r][c] = p[r][c] - k[r] * p[0][c];
+
+    // Predict and correct the state of every joint with the shared gain
+    for (unsigned int i = 0; i < N; ++i) {
+      const double x0 = _x[0][i] + dt * _x[1][i] + 0.5 * dt2 * _x[2][i];
+      const double x1 = _x[1][i] + dt * _x[2][i];
+      const double x2 = _x[2][i];
+      const double residual = q[i] - x0;
+      _x[0][i] = x0 + k[0] * residual;
+      _x[1][i] = x1 + k[1] * residual;
+      _x[2][i] = x2 + k[2] * residual;
+      dq[i] = _x[1][i];
+      ddq[i] = _x[2][i];
+    }
+  }
+};
+
+#endif // PYFRI_JOINT_STATE_ESTIMATOR_H
@@ -0,0 +1,72 @@
+#ifndef PYFRI_KINEMATICS_H
+#define PYFRI_KINEMATICS_H
+
+// Standard library
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friLBRState.h"
+
+// Generated at build time from examples/robots/*.urdf.xacro
+#include "generated_kinematics.h"
+
+// Runtime interface to the generated kernels. Native code that knows the
+// robot at compile time should call e.g. Med7Kinematics directly.
+class Kinematics {
+
+public:
+  virtual ~Kinematics() {}
+
+  virtual const char *name() const = 0;
+
+  virtual const char *base_link() const = 0;
+
+  virtual const char *tip_link() const = 0;
+
+  virtual const char *joint_name(unsigned int i) const = 0;
+
+  // Row-major 4x4 tip transform
+  virtual void forward_kinematics(const double *q, double *transform) const = 0;
+
+  // Row-major 6 x NUMBER_OF_JOINTS geometric Jacobian, linear rows first
+  virtual void jacobian(const double *q, double *jacobian) const = 0;
+};
+
+template <typename Chain> class ChainKinematics : public Kinematics {
+
+  static_assert(Chain::NUMBER_OF_JOINTS ==
+                    KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+                "The kinematic chain must have one joint per LBR joint.");
+
+public:
+  const char *name() const override { return Chain::NAME; }
+
+  const char *base_link() const override { return Chain::BASE_LINK; }
+
+  const char *tip_link() const override { return Chain::TIP_LINK; }
+
+  const char *joint_name(unsigned int i) const override {
+    return Chain::joint_name(i);
+  }
+
+  void forward_kinematics(const double *q, double *transform) const override {
+    Chain::forward_kinematics(q, transform);
+  }
+
+  void jacobian(const double *q, double *jacobian) const override {
+    Chain::jacobian(q, jacobian);
+  }
+};
+
+inline std::unique_ptr<Kinematics> makeKinematics(const std::string &robot) {
+  if (robot == Med7Kinematics::NAME)
+    return std::unique_ptr<Kinematics>(new ChainKinematics<Med7Kinematics>());
+  if (robot == Med14Kinematics::NAME)
+    return std::unique_ptr<Kinematics>(new ChainKinematics<Med14Kinematics>());
+  throw std::runtime_error("Unknown robot '" + robot +
+                           "', expected 'med7' or 'med14'.");
+}
+
+#endif // PYFRI_KINEMATICS_H
@@ -0,0 +1,109 @@
+#ifndef PYFRI_MAILBOX_H
+#define PYFRI_MAILBOX_H
+
+// Standard library
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer mailbox with latest-value
+// semantics (triple buffer). The producer never waits for the consumer and
+// the consumer always sees the most recently written complete value, so it
+// can be read from the FRI thread while Python writes to it.
+template <typename T> class Mailbox {
+
+public:
+  Mailbox() : _middle(1), _back(0), _front(2) {}
+
+  explicit Mailbox(const T &initial) : Mailbox() {
+    for (T &buffer : _buffers)
+      buffer = initial;
+  }
+
+  // Producer: publish a new value
+  void write(const T &value) {
+    _buffers[_back] = value;
+    _back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Consumer: pick up the latest value if a new one was written, returns
+  // whether read() changed.
+  bool update() {
+    if (!(_middle.load(std::memory_order_relaxed) & FRESH))
+      return false;
+    _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  // Consumer: value picked up by the last call to update()
+  const T &read() const { return _buffers[_front]; }
+
+  // Consumer: update() then read()
+  const T &latest() {
+    update();
+    return read();
+  }
+
+private:
+  static constexpr std::uint8_t INDEX = 0x3;
+  static constexpr std::uint8_t FRESH = 0x4;
+
+  T _buffers[3];
+  std::atomic<std::uint8_t> _middle;
+  std::uint8_t _back;  // owned by the producer
+  std::uint8_t _front; // owned by the consumer
+};
+
+// Lock-free single-producer/single-consumer FIFO of up to Capacity values,
+// stored inline so that neither side allocates. Used where every value
+// written from Python must reach the FRI thread, e.g. streamed waypoints.
+template <typename T, std::size_t Capacity> class MessageQueue {
+
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "The capacity must be a power of two.");
+
+public:
+  MessageQueue() : _head(0), _tail(0) {}
+
+  static constexpr std::size_t capacity() { return Capacity; }
+
+  // Producer: returns false if the queue is full
+  bool push(const T &value) {
+    const std::size_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) == Capacity)
+      return false;
+    _values[head & MASK] = value;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer: oldest value or nullptr if the queue is empty, valid until
+  // pop()
+  const T *front() const {
+    const std::size_t tail = _tail.load(std::memory_order_relaxed);
+    if (_head.load(std::memory_order_acquire) == tail)
+      return nullptr;
+    return &_values[tail & MASK];
+  }
+
+  // Consumer: remove the value returned by front()
+  void pop() {
+    _tail.store(_tail.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  // Either side: number of queued values, may be outdated immediately
+  std::size_t size() const {
+    return _head.load(std::memory_order_acquire) -
+           _tail.load(std::memory_order_acquire);
+  }
+
+private:
+  static constexpr std::size_t MASK = Capacity - 1;
+
+  T _values[Capacity];
+  std::atomic<std::size_t> _head; // written by the producer
+  std::atomic<std::size_t> _tail; // written by the consumer
+};
+
+#endif // PYFRI_MAILBOX_H
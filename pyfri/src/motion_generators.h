@@ -0,0 +1,333 @@
+#ifndef PYFRI_MOTION_GENERATORS_H
+#define PYFRI_MOTION_GENERATORS_H
+
+// Standard library
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friLBRClient.h"
+
+#include "mailbox.h"
+#include "native_controllers.h"
+
+// What an overlay generates
+enum class OverlayTarget { JOINT_POSITION, TORQUE, WRENCH };
+
+// Sine waves with one amplitude and frequency per channel, overlaid on the
+// interpolated joint position or commanded as torque or wrench (the first 6
+// channels). Torque and wrench are only commanded in the matching client
+// command mode, the interpolated position is held otherwise. The native
+// counterpart of examples/LBRTorqueSineOverlay.py and
+// examples/LBRWrenchSineOverlay.py.
+class SineOverlay : public NativeController {
+
+public:
+  struct Parameters {
+    JointArray amplitude; // rad, Nm or N/Nm depending on the target
+    JointArray frequency; // Hz
+  };
+
+  SineOverlay(OverlayTarget target, const Parameters &parameters)
+      : _target(target), _parameters(parameters), _mailbox(parameters),
+        _phi() {}
+
+  OverlayTarget target() const { return _target; }
+
+  const Parameters &parameters() const { return _parameters; }
+
+  // Called from Python, takes effect in the next cycle
+  void set_parameters(const Parameters &parameters) {
+    _parameters = parameters;
+    _mailbox.write(parameters);
+  }
+
+  void onStateChange(const KUKA::FRI::LBRState &state,
+                     KUKA::FRI::ESessionState oldState,
+                     KUKA::FRI::ESessionState newState) override {
+    if (newState == KUKA::FRI::ESessionState::MONITORING_READY)
+      _phi.fill(0.0);
+  }
+
+  void command(const KUKA::FRI::LBRState &state,
+               KUKA::FRI::LBRCommand &command) override {
+    const Parameters &p = _mailbox.latest();
+    const double dt = state.getSampleTime();
+
+    double values[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i) {
+      values[i] = p.amplitude[i] * std::sin(_phi[i]);
+      _phi[i] += TWO_PI * p.frequency[i] * dt;
+      if (_phi[i] >= TWO_PI)
+        _phi[i] -= TWO_PI;
+    }
+
+    const double *ipo = state.getIpoJointPosition();
+    const KUKA::FRI::EClientCommandMode mode = state.getClientCommandMode();
+    if (_target == OverlayTarget::JOINT_POSITION) {
+      for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
+        values[i] += ipo[i];
+      commandPosition(state, command, values);
+    } else if (_target == OverlayTarget::TORQUE &&
+               mode == KUKA::FRI::EClientCommandMode::TORQUE) {
+      command.setJointPosition(ipo);
+      command.setTorque(values);
+    } else if (_target == OverlayTarget::WRENCH &&
+               mode == KUKA::FRI::EClientCommandMode::WRENCH) {
+      command.setJointPosition(ipo);
+      command.setWrench(values); // only the first 6 values are used
+    } else {
+      commandIpoPosition(state, command);
+    }
+  }
+
+private:
+  OverlayTarget _target;
+  Parameters _parameters; // last value written from Python
+  Mailbox<Parameters> _mailbox;
+  JointArray _phi;
+};
+
+// Interpolation between two waypoints
+enum class MotionProfile {
+  CUBIC,      // continuous velocity
+  QUINTIC,    // continuous velocity and acceleration
+  MIN_JERK,   // quintic that comes to rest at the waypoint
+  TRAPEZOIDAL // rest to rest within velocity and acceleration limits
+};
+
+struct Waypoint {
+  JointArray position; // rad
+  JointArray velocity; // rad/s at the waypoint, CUBIC and QUINTIC only
+  double duration;     // s from the previous waypoint
+  MotionProfile profile;
+};
+
+// One joint of the segment between two waypoints, evaluated at the time t
+// since the segment started
+class ProfileSegment {
+
+public:
+  // Polynomial from p0, v0, a0 to p1, v1 and zero acceleration in duration
+  void polynomial(MotionProfile profile, double p0, double v0, double a0,
+                  double p1, double v1, double duration) {
+    const double T = duration, h = p1 - p0;
+    _trapezoidal = false;
+    _c[0] = p0;
+    _c[1] = v0;
+    if (profile == MotionProfile::CUBIC) {
+      _c[2] = (3.0 * h - (2.0 * v0 + v1) * T) / (T * T);
+      _c[3] = (-2.0 * h + (v0 + v1) * T) / (T * T * T);
+      _c[4] = 0.0;
+      _c[5] = 0.0;
+    } else {
+      const double T3 = T * T * T;
+      _c[2] = 0.5 * a0;
+      _c[3] = (20.0 * h - (8.0 * v1 + 12.0 * v0) * T - 3.0 * a0 * T * T) /
+              (2.0 * T3);
+      _c[4] = (-30.0 * h + (14.0 * v1 + 16.0 * v0) * T + 3.0 * a0 * T * T) /
+              (2.0 * T3 * T);
+      _c[5] =
+          (12.0 * h - 6.0 * (v1 + v0) * T - a0 * T * T) / (2.0 * T3 * T * T);
+    }
+  }
+
+  // Shortest duration of a trapezoidal profile over distance
+  static double trapezoidalDuration(double distance, double max_velocity,
+                                    double max_acceleration) {
+    distance = std::abs(distance);
+    if (distance * max_acceleration <= max_velocity * max_velocity)
+      return 2.0 * std::sqrt(distance / max_acceleration); // never cruises
+    return distance / max_velocity + max_velocity / max_acceleration;
+  }
+
+  // Rest to rest from p0 to p1 in duration, which must be at least the
+  // trapezoidalDuration() of the distance
+  void trapezoidal(double p0, double p1, double duration,
+                   double max_acceleration) {
+    const double distance = std::abs(p1 - p0), a = max_acceleration,
+                 T = duration;
+    _trapezoidal = true;
+    _c[0] = p0;
+    _c[1] = p1 >= p0 ? 1.0 : -1.0;
+    _c[2] = a;
+    // Cruise velocity that covers the distance in exactly T
+    _c[3] = 0.5 * (a * T - std::sqrt(std::max(0.0, a * a * T * T -
+                                                       4.0 * a * distance)));
+    _c[4] = _c[3] / a; // acceleration time
+    _c[5] = T;
+  }
+
+  void evaluate(double t, double &p, double &v, double &a) const {
+    if (!_trapezoidal) {
+      p = _c[0] +
+          t * (_c[1] + t * (_c[2] + t * (_c[3] + t * (_c[4] + t * _c[5]))));
+      v = _c[1] + t * (2.0 * _c[2] +
+                       t * (3.0 * _c[3] + t * (4.0 * _c[4] + t * 5.0 * _c[5])));
+      a = 2.0 * _c[2] +
+          t * (6.0 * _c[3] + t * (12.0 * _c[4] + t * 20.0 * _c[5]));
+      return;
+    }
+
+    const double sign = _c[1], acceleration = _c[2], cruise = _c[3],
+                 ramp = _c[4], T = _c[5];
+    double distance;
+    if (t < ramp) {
+      distance = 0.5 * acceleration * t * t;
+      v = acceleration * t;
+      a = acceleration;
+    } else if (t < T - ramp) {
+      distance = 0.5 * acceleration * ramp * ramp + cruise * (t - ramp);
+      v = cruise;
+      a = 0.0;
+    } else {
+      const double left = std::max(0.0, T - t);
+      distance = cruise * (T - ramp) - 0.5 * acceleration * left * left;
+      v = acceleration * left;
+      a = -acceleration;
+    }
+    p = _c[0] + sign * distance;
+    v *= sign;
+    a *= sign;
+  }
+
+private:
+  bool _trapezoidal = false;
+  double _c[6] = {}; // coefficients, or the trapezoid's parameters
+};
+
+// Joint trajectory through waypoints streamed from Python. Each waypoint is
+// reached after its duration from the previous one with its profile,
+// starting from the interpolated position when commanding starts. Once all
+// waypoints are reached the last one is held, and new ones continue from
+// there. The set point is evaluated into the command on the FRI thread
+// without allocations.
+class JointTrajectory : public NativeController {
+
+public:
+  static constexpr std::size_t CAPACITY = 1024;
+
+  struct Limits {
+    JointArray max_velocity;     // rad/s
+    JointArray max_acceleration; // rad/s^2
+  };
+
+  JointTrajectory(const Limits &limits)
+      : _limits(limits), _pushed(0), _reached(0), _active(false), _time(0.0),
+        _position(), _velocity(), _acceleration() {}
+
+  const Limits &limits() const { return _limits; }
+
+  // Called from Python, returns false if the queue is full
+  bool push(const Waypoint &waypoint) {
+    if (!_queue.push(waypoint))
+      return false;
+    _pushed++;
+    return true;
+  }
+
+  // Waypoints pushed but not reached yet
+  std::size_t pending() const { return _pushed - _reached; }
+
+  void waitForCommand(const KUKA::FRI::LBRState &state,
+                      KUKA::FRI::LBRCommand &command) override {
+    const double *ipo = state.getIpoJointPosition();
+    std::copy(ipo, ipo + KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+              _position.begin());
+    _velocity.fill(0.0);
+    _acceleration.fill(0.0);
+    _active = false;
+    _time = 0.0;
+    commandIpoPosition(state, command);
+  }
+
+  void command(const KUKA::FRI::LBRState &state,
+               KUKA::FRI::LBRCommand &command) override {
+    advance(state.getSampleTime());
+    commandPosition(state, command, _position.data());
+  }
+
+  // Move the set point forward by dt, public for offline evaluation
+  void advance(double dt) {
+    _time += dt;
+    for (;;) {
+      if (!_active) {
+        const Waypoint *next = _queue.front();
+        if (!next) {
+          // Hold the last waypoint
+          _time = 0.0;
+          _velocity.fill(0.0);
+          _acceleration.fill(0.0);
+          return;
+        }
+        _begin(*next);
+        _queue.pop();
+      }
+      if (_time < _duration) {
+        _evaluate(_time);
+        return;
+      }
+      // Reached the waypoint, carry the remaining time into the next segment
+      _time -= _duration;
+      _evaluate(_duration);
+      _acceleration.fill(0.0);
+      _active = false;
+      _reached++;
+    }
+  }
+
+  const JointArray &position() const { return _position; }
+
+  const JointArray &velocity() const { return _velocity; }
+
+  const JointArray &acceleration() const { return _acceleration; }
+
+private:
+  Limits _limits;
+  MessageQueue<Waypoint, CAPACITY> _queue;
+  std::atomic<std::size_t> _pushed;  // written by Python
+  std::atomic<std::size_t> _reached; // written by the FRI thread
+  bool _active;
+  double _time; // since the start of the active segment
+  double _duration;
+  ProfileSegment _segments[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+  JointArray _position;
+  JointArray _velocity;
+  JointArray _acceleration;
+
+  void _begin(const Waypoint &waypoint) {
+    constexpr unsigned int n = KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+    _duration = waypoint.duration;
+    if (waypoint.profile == MotionProfile::TRAPEZOIDAL) {
+      // Stretch the segment to the slowest joint
+      for (unsigned int i = 0; i < n; ++i)
+        _duration = std::max(
+            _duration, ProfileSegment::trapezoidalDuration(
+                           waypoint.position[i] - _position[i],
+                           _limits.max_velocity[i],
+                           _limits.max_acceleration[i]));
+      for (unsigned int i = 0; i < n; ++i)
+        _segments[i].trapezoidal(_position[i], waypoint.position[i], _duration,
+                                 _limits.max_acceleration[i]);
+    } else {
+      for (unsigned int i = 0; i < n; ++i) {
+        const double v1 = waypoint.profile == MotionProfile::MIN_JERK
+                              ? 0.0
+                              : waypoint.velocity[i];
+        _segments[i].polynomial(waypoint.profile, _position[i], _velocity[i],
+                                _acceleration[i], waypoint.position[i], v1,
+                                _duration);
+      }
+    }
+    _active = true;
+  }
+
+  void _evaluate(double t) {
+    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
+      _segments[i].evaluate(t, _position[i], _velocity[i], _acceleration[i]);
+  }
+};
+
+#endif // PYFRI_MOTION_GENERATORS_H
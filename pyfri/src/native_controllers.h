@@ -0,0 +1,357 @@
+#ifndef PYFRI_NATIVE_CONTROLLERS_H
+#define PYFRI_NATIVE_CONTROLLERS_H
+
+// Standard library
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friLBRClient.h"
+
+#include "cycle_statistics.h"
+#include "mailbox.h"
+
+using JointArray = std::array<double, KUKA::FRI::LBRState::NUMBER_OF_JOINTS>;
+
+constexpr double TWO_PI = 6.283185307179586;
+
+// Command the joint position and, depending on the client command mode, zero
+// torque/wrench
+inline void commandPosition(const KUKA::FRI::LBRState &state,
+                            KUKA::FRI::LBRCommand &command,
+                            const double *position) {
+  command.setJointPosition(position);
+
+  const double zeros[KUKA::FRI::LBRState::NUMBER_OF_JOINTS] = {};
+  switch (state.getClientCommandMode()) {
+  case KUKA::FRI::EClientCommandMode::TORQUE:
+    command.setTorque(zeros);
+    break;
+  case KUKA::FRI::EClientCommandMode::WRENCH:
+    command.setWrench(zeros); // only the first 6 values are used
+    break;
+  default:
+    break;
+  }
+}
+
+#if FRI_CLIENT_VERSION_MAJOR == 2
+// Whether the client commands a Cartesian pose instead of joint positions
+inline bool commandsCartesianPose(const KUKA::FRI::LBRState &state) {
+  return state.getClientCommandMode() ==
+         KUKA::FRI::EClientCommandMode::CARTESIAN_POSE;
+}
+#endif
+
+// Command the interpolated joint position and, depending on the client
+// command mode, zero torque/wrench, or the interpolated pose in the
+// CARTESIAN_POSE mode of FRI 2. This mirrors the default behaviour of
+// KUKA::FRI::LBRClient.
+inline void commandIpoPosition(const KUKA::FRI::LBRState &state,
+                               KUKA::FRI::LBRCommand &command) {
+#if FRI_CLIENT_VERSION_MAJOR == 2
+  if (commandsCartesianPose(state)) {
+    command.setCartesianPose(state.getIpoCartesianPose());
+    return;
+  }
+#endif
+  commandPosition(state, command, state.getIpoJointPosition());
+}
+
+// Controller compiled into the module. When one is set on an LBRClient, the
+// client callbacks run it directly inside step() without taking the GIL.
+// Controllers are only called from the FRI thread; Python changes their
+// parameters through a Mailbox.
+class NativeController {
+
+public:
+  virtual ~NativeController() {}
+
+  virtual void onStateChange(const KUKA::FRI::LBRState &state,
+                             KUKA::FRI::ESessionState oldState,
+                             KUKA::FRI::ESessionState newState) {}
+
+  virtual void monitor(const KUKA::FRI::LBRState &state) {}
+
+  virtual void waitForCommand(const KUKA::FRI::LBRState &state,
+                              KUKA::FRI::LBRCommand &command) {
+    commandIpoPosition(state, command);
+  }
+
+  virtual void command(const KUKA::FRI::LBRState &state,
+                       KUKA::FRI::LBRCommand &command) = 0;
+};
+
+// Sine wave overlaid on the interpolated joint position, the native
+// counterpart of examples/LBRJointSineOverlay.py.
+class JointSineOverlay : public NativeController {
+
+public:
+  struct Parameters {
+    JointArray amplitude;      // rad, zero for joints that should not move
+    double frequency;          // Hz
+    double filter_coefficient; // exponential smoothing of the offset
+  };
+
+  JointSineOverlay(const Parameters &parameters)
+      : _parameters(parameters), _mailbox(parameters), _offset(0.0),
+        _phi(0.0) {}
+
+  const Parameters &parameters() const { return _parameters; }
+
+  // Called from Python, takes effect in the next cycle
+  void set_parameters(const Parameters &parameters) {
+    _parameters = parameters;
+    _mailbox.write(parameters);
+  }
+
+  void onStateChange(const KUKA::FRI::LBRState &state,
+                     KUKA::FRI::ESessionState oldState,
+                     KUKA::FRI::ESessionState newState) override {
+    if (newState == KUKA::FRI::ESessionState::MONITORING_READY) {
+      _offset = 0.0;
+      _phi = 0.0;
+    }
+  }
+
+  void command(const KUKA::FRI::LBRState &state,
+               KUKA::FRI::LBRCommand &command) override {
+    const Parameters &p = _mailbox.latest();
+
+    const double new_offset = std::sin(_phi);
+    _offset = (_offset * p.filter_coefficient) +
+              (new_offset * (1.0 - p.filter_coefficient));
+    _phi += TWO_PI * p.frequency * state.getSampleTime();
+    if (_phi >= TWO_PI)
+      _phi -= TWO_PI;
+
+    const double *ipo = state.getIpoJointPosition();
+    double position[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
+      position[i] = ipo[i] + p.amplitude[i] * _offset;
+    command.setJointPosition(position);
+  }
+
+private:
+  Parameters _parameters; // last value written from Python
+  Mailbox<Parameters> _mailbox;
+  double _offset;
+  double _phi;
+};
+
+// Joint space spring-damper added as a torque overlay. Requires the TORQUE
+// client command mode (and joint impedance control on the robot); in any
+// other mode the interpolated position is held.
+class JointImpedance : public NativeController {
+
+public:
+  struct Parameters {
+    JointArray stiffness;  // Nm/rad
+    JointArray damping;    // Nms/rad
+    JointArray max_torque; // Nm, the overlay is clipped to +/- this value
+    JointArray target;     // rad, only used if has_target is set
+    bool has_target;       // otherwise hold the position at command start
+  };
+
+  JointImpedance(const Parameters &parameters)
+      : _parameters(parameters), _mailbox(parameters) {}
+
+  const Parameters &parameters() const { return _parameters; }
+
+  // Called from Python, takes effect in the next cycle
+  void set_parameters(const Parameters &parameters) {
+    _parameters = parameters;
+    _mailbox.write(parameters);
+  }
+
+  void waitForCommand(const KUKA::FRI::LBRState &state,
+                      KUKA::FRI::LBRCommand &command) override {
+    const double *q = state.getMeasuredJointPosition();
+    std::copy(q, q + KUKA::FRI::LBRState::NUMBER_OF_JOINTS, _q_prev.begin());
+    std::copy(q, q + KUKA::FRI::LBRState::NUMBER_OF_JOINTS, _hold.begin());
+    commandIpoPosition(state, command);
+  }
+
+  void command(const KUKA::FRI::LBRState &state,
+               KUKA::FRI::LBRCommand &command) override {
+    if (state.getClientCommandMode() != KUKA::FRI::EClientCommandMode::TORQUE) {
+      commandIpoPosition(state, command);
+      return;
+    }
+
+    const Parameters &p = _mailbox.latest();
+    const JointArray &target = p.has_target ? p.target : _hold;
+    const double dt = state.getSampleTime();
+    const double *q = state.getMeasuredJointPosition();
+
+    double torque[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i) {
+      const double dq = (q[i] - _q_prev[i]) / dt;
+      const double tau =
+          p.stiffness[i] * (target[i] - q[i]) - p.damping[i] * dq;
+      torque[i] = std::max(-p.max_torque[i], std::min(tau, p.max_torque[i]));
+      _q_prev[i] = q[i];
+    }
+
+    // Track the measured position so that the robot's own spring is not
+    // stretched, the overlay torque provides the stiffness
+    command.setJointPosition(q);
+    command.setTorque(torque);
+  }
+
+private:
+  Parameters _parameters; // last value written from Python
+  Mailbox<Parameters> _mailbox;
+  JointArray _q_prev = {};
+  JointArray _hold = {};
+};
+
+// Applies the latest command written from Python, e.g. by an input device
+// thread at its own rate while the FRI cycle runs on the background thread.
+// Until a command is written after commanding starts, the interpolated
+// position is held. Optionally, positions are interpolated over the interval
+// between writes, the joint velocity is limited and commands older than a
+// timeout are dropped (the position is held and torque/wrench are zeroed).
+class CommandMailbox : public NativeController {
+
+public:
+  struct Command {
+    JointArray position;
+    JointArray torque;
+    std::array<double, 6> wrench;
+    bool has_position;
+    bool has_torque;
+    bool has_wrench;
+    long long time; // steady clock, ns, set by write()
+  };
+
+  struct Parameters {
+    double timeout;          // s, 0 never drops commands
+    JointArray max_velocity; // rad/s, 0 for no limit
+    bool interpolate;        // first-order hold between written positions
+  };
+
+  // Longest interval a position is interpolated over, longer gaps between
+  // writes move within this time
+  static constexpr double MAX_INTERPOLATION = 0.1;
+
+  CommandMailbox(const Parameters &parameters = Parameters{})
+      : _parameters(parameters), _parameters_mailbox(parameters),
+        _mailbox(Command{}), _fresh(false), _stale(0) {}
+
+  const Parameters &parameters() const { return _parameters; }
+
+  // Called from Python, takes effect in the next cycle
+  void set_parameters(const Parameters &parameters) {
+    _parameters = parameters;
+    _parameters_mailbox.write(parameters);
+  }
+
+  // Called from Python, replaces the previous command
+  void write(Command command) {
+    command.time = steadyTimeInNanoseconds();
+    _mailbox.write(command);
+  }
+
+  // Cycles in which the latest command was older than the timeout
+  unsigned long long stale_cycles() const { return _stale; }
+
+  void waitForCommand(const KUKA::FRI::LBRState &state,
+                      KUKA::FRI::LBRCommand &command) override {
+    // Discard commands from a previous session
+    _mailbox.update();
+    _fresh = false;
+    _hold(state);
+    commandIpoPosition(state, command);
+  }
+
+  void command(const KUKA::FRI::LBRState &state,
+               KUKA::FRI::LBRCommand &command) override {
+    const Parameters &p = _parameters_mailbox.latest();
+    const double dt = state.getSampleTime();
+    const bool written = _mailbox.update();
+    _fresh |= written;
+    if (!_fresh) {
+      _hold(state);
+      commandIpoPosition(state, command);
+      return;
+    }
+
+    const Command &c = _mailbox.read();
+    const bool stale =
+        p.timeout > 0.0 && steadyTimeInNanoseconds() - c.time > p.timeout * 1e9;
+    if (stale) {
+      _stale.fetch_add(1, std::memory_order_relaxed);
+      commandPosition(state, command, _position.data());
+      return;
+    }
+
+    if (c.has_position) {
+      if (written) {
+        // Interpolate from the current set point over the write interval
+        _from = _position;
+        _interval = _previous_time > 0
+                        ? std::min((c.time - _previous_time) * 1e-9,
+                                   MAX_INTERPOLATION)
+                        : 0.0;
+        _elapsed = 0.0;
+        _previous_time = c.time;
+      }
+      _elapsed += dt;
+      const double alpha = p.interpolate && _interval > _elapsed
+                               ? _elapsed / _interval
+                               : 1.0;
+      for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+           ++i) {
+        double step = _from[i] + alpha * (c.position[i] - _from[i]) -
+                      _position[i];
+        if (p.max_velocity[i] > 0.0)
+          step = std::max(-p.max_velocity[i] * dt,
+                          std::min(step, p.max_velocity[i] * dt));
+        _position[i] += step;
+      }
+    } else {
+      const double *ipo = state.getIpoJointPosition();
+      std::copy(ipo, ipo + KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+                _position.begin());
+    }
+    command.setJointPosition(_position.data());
+
+    const double zeros[KUKA::FRI::LBRState::NUMBER_OF_JOINTS] = {};
+    switch (state.getClientCommandMode()) {
+    case KUKA::FRI::EClientCommandMode::TORQUE:
+      command.setTorque(c.has_torque ? c.torque.data() : zeros);
+      break;
+    case KUKA::FRI::EClientCommandMode::WRENCH:
+      command.setWrench(c.has_wrench ? c.wrench.data() : zeros);
+      break;
+    default:
+      break;
+    }
+  }
+
+private:
+  Parameters _parameters; // last value written from Python
+  Mailbox<Parameters> _parameters_mailbox;
+  Mailbox<Command> _mailbox;
+  bool _fresh; // a command was written since commanding started
+  std::atomic<unsigned long long> _stale;
+
+  // Set point, and the interpolation of the latest written position
+  JointArray _position = {};
+  JointArray _from = {};
+  double _interval = 0.0;
+  double _elapsed = 0.0;
+  long long _previous_time = 0;
+
+  void _hold(const KUKA::FRI::LBRState &state) {
+    const double *ipo = state.getIpoJointPosition();
+    std::copy(ipo, ipo + KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+              _position.begin());
+    _previous_time = 0;
+  }
+};
+
+#endif // PYFRI_NATIVE_CONTROLLERS_H
@@ -0,0 +1,127 @@
+#ifndef PYFRI_POSE_CONVERSIONS_H
+#define PYFRI_POSE_CONVERSIONS_H
+
+// Standard library
+#include <cmath>
+
+// Cartesian pose as used by the FRI 2 overlay: [x, y, z, qw, qx, qy, qz]
+constexpr unsigned int QUATERNION_POSE_SIZE = 7;
+
+// Cartesian pose in the KUKA convention: [x, y, z, A, B, C] with
+// R = Rz(A) * Ry(B) * Rx(C), angles in radians
+constexpr unsigned int ABC_POSE_SIZE = 6;
+
+// The transforms are row-major 4x4 homogeneous matrices, as returned by
+// Kinematics::forward_kinematics. The translation is passed through unchanged.
+
+inline void setTransformTranslation(const double *xyz, double *transform) {
+  transform[3] = xyz[0];
+  transform[7] = xyz[1];
+  transform[11] = xyz[2];
+  transform[12] = 0.0;
+  transform[13] = 0.0;
+  transform[14] = 0.0;
+  transform[15] = 1.0;
+}
+
+// The quaternion need not be normalized
+inline void quaternionPoseToMatrix(const double *pose, double *transform) {
+  const double norm = std::sqrt(pose[3] * pose[3] + pose[4] * pose[4] +
+                                pose[5] * pose[5] + pose[6] * pose[6]);
+  const double s = norm > 0.0 ? 1.0 / norm : 0.0;
+  const double w = pose[3] * s, x = pose[4] * s, y = pose[5] * s,
+               z = pose[6] * s;
+
+  transform[0] = 1.0 - 2.0 * (y * y + z * z);
+  transform[1] = 2.0 * (x * y - w * z);
+  transform[2] = 2.0 * (x * z + w * y);
+  transform[4] = 2.0 * (x * y + w * z);
+  transform[5] = 1.0 - 2.0 * (x * x + z * z);
+  transform[6] = 2.0 * (y * z - w * x);
+  transform[8] = 2.0 * (x * z - w * y);
+  transform[9] = 2.0 * (y * z + w * x);
+  transform[10] = 1.0 - 2.0 * (x * x + y * y);
+  setTransformTranslation(pose, transform);
+}
+
+// Shepperd's method, converting from the largest diagonal term keeps the
+// result accurate for every rotation. Returns qw >= 0.
+inline void matrixToQuaternionPose(const double *transform, double *pose) {
+  const double r00 = transform[0], r01 = transform[1], r02 = transform[2];
+  const double r10 = transform[4], r11 = transform[5], r12 = transform[6];
+  const double r20 = transform[8], r21 = transform[9], r22 = transform[10];
+  const double trace = r00 + r11 + r22;
+
+  double w, x, y, z;
+  if (trace >= r00 && trace >= r11 && trace >= r22) {
+    const double s = 2.0 * std::sqrt(1.0 + trace);
+    w = 0.25 * s;
+    x = (r21 - r12) / s;
+    y = (r02 - r20) / s;
+    z = (r10 - r01) / s;
+  } else if (r00 >= r11 && r00 >= r22) {
+    const double s = 2.0 * std::sqrt(1.0 + r00 - r11 - r22);
+    w = (r21 - r12) / s;
+    x = 0.25 * s;
+    y = (r01 + r10) / s;
+    z = (r02 + r20) / s;
+  } else if (r11 >= r22) {
+    const double s = 2.0 * std::sqrt(1.0 + r11 - r00 - r22);
+    w = (r02 - r20) / s;
+    x = (r01 + r10) / s;
+    y = 0.25 * s;
+    z = (r12 + r21) / s;
+  } else {
+    const double s = 2.0 * std::sqrt(1.0 + r22 - r00 - r11);
+    w = (r10 - r01) / s;
+    x = (r02 + r20) / s;
+    y = (r12 + r21) / s;
+    z = 0.25 * s;
+  }
+  const double sign = w < 0.0 ? -1.0 : 1.0;
+
+  pose[0] = transform[3];
+  pose[1] = transform[7];
+  pose[2] = transform[11];
+  pose[3] = sign * w;
+  pose[4] = sign * x;
+  pose[5] = sign * y;
+  pose[6] = sign * z;
+}
+
+inline void abcPoseToMatrix(const double *pose, double *transform) {
+  const double ca = std::cos(pose[3]), sa = std::sin(pose[3]);
+  const double cb = std::cos(pose[4]), sb = std::sin(pose[4]);
+  const double cc = std::cos(pose[5]), sc = std::sin(pose[5]);
+
+  transform[0] = ca * cb;
+  transform[1] = ca * sb * sc - sa * cc;
+  transform[2] = ca * sb * cc + sa * sc;
+  transform[4] = sa * cb;
+  transform[5] = sa * sb * sc + ca * cc;
+  transform[6] = sa * sb * cc - ca * sc;
+  transform[8] = -sb;
+  transform[9] = cb * sc;
+  transform[10] = cb * cc;
+  setTransformTranslation(pose, transform);
+}
+
+// At B = +-pi/2 only A -+ C is defined, A is then reported as 0
+inline void matrixToAbcPose(const double *transform, double *pose) {
+  const double cb = std::hypot(transform[0], transform[4]);
+
+  pose[0] = transform[3];
+  pose[1] = transform[7];
+  pose[2] = transform[11];
+  pose[4] = std::atan2(-transform[8], cb);
+  if (cb > 1e-12) {
+    pose[3] = std::atan2(transform[4], transform[0]);
+    pose[5] = std::atan2(transform[9], transform[10]);
+  } else {
+    const double sb = transform[8] < 0.0 ? 1.0 : -1.0;
+    pose[3] = 0.0;
+    pose[5] = std::atan2(sb * transform[1], transform[5]);
+  }
+}
+
+#endif // PYFRI_POSE_CONVERSIONS_H
@@ -0,0 +1,119 @@
+#ifndef PYFRI_PSEUDO_INVERSE_H
+#define PYFRI_PSEUDO_INVERSE_H
+
+// Standard library
+#include <algorithm>
+#include <cmath>
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friLBRState.h"
+
+// Rows of a geometric Jacobian (linear and angular velocity)
+constexpr unsigned int TASK_DIMENSION = 6;
+
+// Pseudo-inverse of a row-major TASK_DIMENSION x NUMBER_OF_JOINTS Jacobian
+// into a row-major NUMBER_OF_JOINTS x TASK_DIMENSION matrix.
+//
+// With J J^T = U S^2 U^T (cyclic Jacobi on the 6x6 symmetric matrix, which
+// is much cheaper than an SVD of J), the inverse is J^T U W U^T with
+// W = 1 / (s^2 + damping^2). Singular values s <= rcond * max(s) are
+// dropped and damping > 0 gives the damped least-squares inverse.
+//
+// The eigenvalues s^2 are only accurate to about eps * max(s)^2, so singular
+// values below sqrt(eps) * max(s) cannot be told apart from zero. rcond is
+// therefore at least PSEUDO_INVERSE_MIN_RCOND; with damping = 0 the result
+// matches numpy.linalg.pinv with the same rcond while the smallest kept
+// singular value stays well above that bound.
+constexpr double PSEUDO_INVERSE_MIN_RCOND = 1.5e-8; // about sqrt(eps)
+
+inline void pseudoInverse(const double *jacobian, double rcond, double damping,
+                          double *inverse) {
+  constexpr unsigned int M = TASK_DIMENSION;
+  constexpr unsigned int N = KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+
+  // A = J J^T
+  double a[M][M];
+  for (unsigned int r = 0; r < M; ++r)
+    for (unsigned int c = r; c < M; ++c) {
+      double sum = 0.0;
+      for (unsigned int k = 0; k < N; ++k)
+        sum += jacobian[r * N + k] * jacobian[c * N + k];
+      a[r][c] = sum;
+      a[c][r] = sum;
+    }
+
+  // Eigenvectors of A in the columns of u
+  double u[M][M] = {};
+  for (unsigned int i = 0; i < M; ++i)
+    u[i][i] = 1.0;
+
+  for (unsigned int sweep = 0; sweep < 50; ++sweep) {
+    double off = 0.0, diagonal = 0.0;
+    for (unsigned int r = 0; r < M; ++r) {
+      diagonal += a[r][r] * a[r][r];
+      for (unsigned int c = r + 1; c < M; ++c)
+        off += a[r][c] * a[r][c];
+    }
+    if (off <= 1e-30 * diagonal)
+      break;
+
+    for (unsigned int p = 0; p < M; ++p)
+      for (unsigned int q = p + 1; q < M; ++q) {
+        if (a[p][q] == 0.0)
+          continue;
+        // Rotation that zeroes a[p][q]
+        const double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+        const double t = (theta >= 0.0 ? 1.0 : -1.0) /
+                         (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+        const double c = 1.0 / std::sqrt(t * t + 1.0);
+        const double s = t * c;
+        for (unsigned int k = 0; k < M; ++k) {
+          const double akp = a[k][p], akq = a[k][q];
+          a[k][p] = c * akp - s * akq;
+          a[k][q] = s * akp + c * akq;
+        }
+        for (unsigned int k = 0; k < M; ++k) {
+          const double apk = a[p][k], aqk = a[q][k];
+          a[p][k] = c * apk - s * aqk;
+          a[q][k] = s * apk + c * aqk;
+        }
+        for (unsigned int k = 0; k < M; ++k) {
+          const double ukp = u[k][p], ukq = u[k][q];
+          u[k][p] = c * ukp - s * ukq;
+          u[k][q] = s * ukp + c * ukq;
+        }
+      }
+  }
+
+  // Weights of the eigenvectors, the eigenvalues are the squared singular
+  // values of J
+  double largest = 0.0;
+  for (unsigned int i = 0; i < M; ++i)
+    largest = std::max(largest, a[i][i]);
+  const double relative = std::max(rcond, PSEUDO_INVERSE_MIN_RCOND);
+  const double cutoff = relative * relative * largest;
+  double w[M];
+  for (unsigned int i = 0; i < M; ++i)
+    w[i] = a[i][i] > cutoff && a[i][i] > 0.0
+               ? 1.0 / (a[i][i] + damping * damping)
+               : 0.0;
+
+  // B = U W U^T, then inverse = J^T B
+  double b[M][M];
+  for (unsigned int r = 0; r < M; ++r)
+    for (unsigned int c = 0; c < M; ++c) {
+      double sum = 0.0;
+      for (unsigned int k = 0; k < M; ++k)
+        sum += u[r][k] * w[k] * u[c][k];
+      b[r][c] = sum;
+    }
+  for (unsigned int j = 0; j < N; ++j)
+    for (unsigned int c = 0; c < M; ++c) {
+      double sum = 0.0;
+      for (unsigned int k = 0; k < M; ++k)
+        sum += jacobian[k * N + j] * b[k][c];
+      inverse[j * M + c] = sum;
+    }
+}
+
+#endif // PYFRI_PSEUDO_INVERSE_H
@@ -0,0 +1,47 @@
+#ifndef PYFRI_REALTIME_THREAD_H
+#define PYFRI_REALTIME_THREAD_H
+
+// Standard library
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Configure the calling thread for realtime use. A priority > 0 selects
+// SCHED_FIFO with that priority, a cpu >= 0 pins the thread to that CPU.
+// Returns an empty string on success, otherwise a description of the error.
+inline std::string configureRealtimeThread(int priority, int cpu) {
+#ifdef __linux__
+  if (cpu >= 0) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    const int error =
+        pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (error != 0)
+      return "Failed to pin thread to CPU " + std::to_string(cpu) + ": " +
+             std::strerror(error);
+  }
+
+  if (priority > 0) {
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0)
+      return "Failed to set SCHED_FIFO priority " + std::to_string(priority) +
+             ": " + std::strerror(error);
+  }
+
+  return "";
+#else
+  if (priority > 0 || cpu >= 0)
+    return "Thread priority and CPU affinity are only supported on Linux.";
+  return "";
+#endif
+}
+
+#endif // PYFRI_REALTIME_THREAD_H
@@ -0,0 +1,91 @@
+#ifndef PYFRI_RING_BUFFER_H
+#define PYFRI_RING_BUFFER_H
+
+// Standard library
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+// Single-producer/single-consumer ring buffer of fixed-size records. The
+// storage is allocated once on construction, the producer side never blocks
+// or allocates, and is therefore safe to use from the FRI thread. Records are
+// made up of 8-byte words so that any double/integer field can be written in
+// place.
+class RingBuffer {
+
+public:
+  RingBuffer(std::size_t capacity, std::size_t record_words)
+      : _record_words(record_words), _head(0), _tail(0) {
+
+    // Round capacity up to a power of two so indices can be masked
+    std::size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+
+    if (record_words == 0)
+      throw std::runtime_error("Ring buffer records must not be empty.");
+
+    _capacity = size;
+    _mask = size - 1;
+    _storage = std::make_unique<std::uint64_t[]>(_capacity * _record_words);
+  }
+
+  std::size_t capacity() const { return _capacity; }
+
+  std::size_t record_words() const { return _record_words; }
+
+  // Producer: returns the next free record or nullptr if the buffer is full.
+  // The record becomes visible to the consumer once commit() is called.
+  std::uint64_t *claim() {
+    const std::size_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) == _capacity)
+      return nullptr;
+    return _slot(head);
+  }
+
+  void commit() {
+    _head.store(_head.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  // Consumer: number of committed records not yet released.
+  std::size_t available() const {
+    return _head.load(std::memory_order_acquire) -
+           _tail.load(std::memory_order_relaxed);
+  }
+
+  // Consumer: i-th unread record, i < available().
+  const std::uint64_t *peek(std::size_t i) const {
+    return _slot(_tail.load(std::memory_order_relaxed) + i);
+  }
+
+  // Consumer: number of unread records that are contiguous in memory starting
+  // at peek(0), at most n.
+  std::size_t contiguous(std::size_t n) const {
+    const std::size_t first = _tail.load(std::memory_order_relaxed) & _mask;
+    return n < _capacity - first ? n : _capacity - first;
+  }
+
+  void release(std::size_t n) {
+    _tail.store(_tail.load(std::memory_order_relaxed) + n,
+                std::memory_order_release);
+  }
+
+private:
+  std::size_t _capacity;
+  std::size_t _mask;
+  std::size_t _record_words;
+  std::unique_ptr<std::uint64_t[]> _storage;
+
+  // Keep producer and consumer indices on separate cache lines
+  alignas(64) std::atomic<std::size_t> _head;
+  alignas(64) std::atomic<std::size_t> _tail;
+
+  std::uint64_t *_slot(std::size_t index) const {
+    return _storage.get() + (index & _mask) * _record_words;
+  }
+};
+
+#endif // PYFRI_RING_BUFFER_H
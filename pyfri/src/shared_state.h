@@ -0,0 +1,313 @@
+#ifndef PYFRI_SHARED_STATE_H
+#define PYFRI_SHARED_STATE_H
+
+// Standard library
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "state_snapshot.h"
+
+// Shared-memory ring of LBRStateSnapshot records, written by one
+// ClientApplication and read by any number of local processes. The segment
+// is a POSIX shared-memory object (/dev/shm/<name> on Linux) laid out as
+//
+//   offset 0   SharedStateHeader          64 bytes
+//   offset 64  slot[0] ... slot[N - 1]    slot_size bytes each
+//
+// Each slot is a uint64 sequence followed by the snapshot (STATE_SNAPSHOT_DTYPE
+// layout), padded to a multiple of 64 bytes. Sample n (counting from 0) goes
+// into slot n % N. While it is written the slot's sequence is 2n + 1, once
+// complete it is 2n + 2, so a reader that sees the same even sequence before
+// and after copying the snapshot has a consistent sample (seqlock). The
+// header's `published` counter is the number of complete samples. All values
+// are in native byte order.
+struct SharedStateHeader {
+  char magic[8];               // "PYFRISHM"
+  std::uint32_t version;       // SHARED_STATE_VERSION
+  std::uint32_t slot_count;    // N
+  std::uint32_t slot_size;     // bytes per slot
+  std::uint32_t snapshot_size; // sizeof(LBRStateSnapshot)
+  std::uint32_t fri_version;   // FRI_CLIENT_VERSION_MAJOR of the publisher
+  std::uint32_t reserved0;
+  std::atomic<std::uint64_t> published;
+  std::uint64_t reserved[3];
+};
+
+struct SharedStateSlot {
+  std::atomic<std::uint64_t> sequence;
+  LBRStateSnapshot snapshot;
+};
+
+constexpr char SHARED_STATE_MAGIC[8] = {'P', 'Y', 'F', 'R', 'I', 'S', 'H', 'M'};
+constexpr std::uint32_t SHARED_STATE_VERSION = 1;
+constexpr std::size_t SHARED_STATE_SLOT_SIZE =
+    (sizeof(SharedStateSlot) + 63) / 64 * 64;
+
+static_assert(sizeof(SharedStateHeader) == 64,
+              "The shared state header must be 64 bytes.");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "Shared-memory sequences require lock-free 64 bit atomics.");
+
+// Maps a shared-memory object, either creating it (publisher) or opening an
+// existing one read-only (reader).
+class SharedMemory {
+
+public:
+  SharedMemory(const std::string &name, std::size_t size, bool create)
+      : _name(_objectName(name)), _data(nullptr), _size(0), _owner(create) {
+#ifdef _WIN32
+    throw std::runtime_error(
+        "Shared-memory state is only supported on POSIX systems.");
+#else
+    const int fd = create ? shm_open(_name.c_str(), O_CREAT | O_RDWR, 0644)
+                          : shm_open(_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      throw std::runtime_error("Failed to open shared memory " + _name + ": " +
+                               std::strerror(errno));
+
+    if (create) {
+      if (ftruncate(fd, size) != 0) {
+        const int error = errno;
+        close(fd);
+        shm_unlink(_name.c_str());
+        throw std::runtime_error("Failed to resize shared memory " + _name +
+                                 ": " + std::strerror(error));
+      }
+    } else {
+      struct stat info;
+      if (fstat(fd, &info) != 0) {
+        const int error = errno;
+        close(fd);
+        throw std::runtime_error("Failed to stat shared memory " + _name +
+                                 ": " + std::strerror(error));
+      }
+      size = static_cast<std::size_t>(info.st_size);
+    }
+
+    void *data =
+        size > 0 ? mmap(nullptr, size, create ? PROT_READ | PROT_WRITE
+                                              : PROT_READ,
+                        MAP_SHARED, fd, 0)
+                 : MAP_FAILED;
+    const int error = size > 0 ? errno : EINVAL;
+    close(fd); // the mapping keeps the object alive
+    if (data == MAP_FAILED) {
+      if (create)
+        shm_unlink(_name.c_str());
+      throw std::runtime_error("Failed to map shared memory " + _name + ": " +
+                               std::strerror(error));
+    }
+    _data = data;
+    _size = size;
+#endif
+  }
+
+  SharedMemory(const SharedMemory &) = delete;
+  SharedMemory &operator=(const SharedMemory &) = delete;
+
+  ~SharedMemory() {
+#ifndef _WIN32
+    if (_data)
+      munmap(_data, _size);
+    // Readers that already mapped the segment keep their mapping
+    if (_owner)
+      shm_unlink(_name.c_str());
+#endif
+  }
+
+  const std::string &name() const { return _name; }
+
+  void *data() const { return _data; }
+
+  std::size_t size() const { return _size; }
+
+private:
+  std::string _name;
+  void *_data;
+  std::size_t _size;
+  bool _owner;
+
+  // POSIX shared-memory names start with a single slash
+  static std::string _objectName(const std::string &name) {
+    if (name.empty() || name.find('/', 1) != std::string::npos)
+      throw std::runtime_error("Invalid shared memory name '" + name +
+                               "', it must not contain '/'.");
+    return name[0] == '/' ? name : "/" + name;
+  }
+};
+
+// Writer side, called from the thread running step()
+class SharedStatePublisher {
+
+public:
+  SharedStatePublisher(const std::string &name, std::size_t slot_count)
+      : _memory(name, _checkedSize(slot_count), true), _published(0) {
+    // A stale segment of the same name is reused, invalidate it first
+    SharedStateHeader *header = _header();
+    std::memset(header->magic, 0, sizeof(header->magic));
+    std::atomic_thread_fence(std::memory_order_release);
+    header->published.store(0, std::memory_order_relaxed);
+    header->version = SHARED_STATE_VERSION;
+    header->slot_count = static_cast<std::uint32_t>(slot_count);
+    header->slot_size = static_cast<std::uint32_t>(SHARED_STATE_SLOT_SIZE);
+    header->snapshot_size =
+        static_cast<std::uint32_t>(sizeof(LBRStateSnapshot));
+    header->fri_version = FRI_CLIENT_VERSION_MAJOR;
+    for (std::size_t i = 0; i < slot_count; ++i)
+      _slot(i)->sequence.store(0, std::memory_order_relaxed);
+
+    // Readers check the magic last, so it is written once all else is set
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, SHARED_STATE_MAGIC, sizeof(header->magic));
+  }
+
+  const std::string &name() const { return _memory.name(); }
+
+  std::uint64_t published() const { return _published; }
+
+  void publish(const KUKA::FRI::LBRState &state) {
+    // The state is read before the slot is marked as being written, so a
+    // throwing getter cannot leave its sequence odd
+    takeSnapshot(state, _snapshot);
+    SharedStateSlot *slot = _slot(_published % _header()->slot_count);
+    slot->sequence.store(2 * _published + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot->snapshot, &_snapshot, sizeof(LBRStateSnapshot));
+    slot->sequence.store(2 * _published + 2, std::memory_order_release);
+    _header()->published.store(++_published, std::memory_order_release);
+  }
+
+private:
+  SharedMemory _memory;
+  std::uint64_t _published;
+  LBRStateSnapshot _snapshot;
+
+  static std::size_t _checkedSize(std::size_t slot_count) {
+    if (slot_count == 0 || slot_count > UINT32_MAX)
+      throw std::runtime_error("The number of slots must be in [1, 2^32).");
+    return sizeof(SharedStateHeader) + slot_count * SHARED_STATE_SLOT_SIZE;
+  }
+
+  SharedStateHeader *_header() const {
+    return static_cast<SharedStateHeader *>(_memory.data());
+  }
+
+  SharedStateSlot *_slot(std::size_t i) const {
+    return reinterpret_cast<SharedStateSlot *>(
+        static_cast<char *>(_memory.data()) + sizeof(SharedStateHeader) +
+        i * SHARED_STATE_SLOT_SIZE);
+  }
+};
+
+// Reader side, never blocks the publisher
+class SharedStateReader {
+
+public:
+  SharedStateReader(const std::string &name) : _memory(name, 0, false) {
+    if (_memory.size() < sizeof(SharedStateHeader) ||
+        std::memcmp(_header()->magic, SHARED_STATE_MAGIC,
+                    sizeof(SHARED_STATE_MAGIC)) != 0)
+      throw std::runtime_error(_memory.name() +
+                               " is not a pyfri shared state segment.");
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    const SharedStateHeader *header = _header();
+    if (header->version != SHARED_STATE_VERSION ||
+        header->snapshot_size != sizeof(LBRStateSnapshot) ||
+        header->slot_size != SHARED_STATE_SLOT_SIZE ||
+        header->fri_version != FRI_CLIENT_VERSION_MAJOR)
+      throw std::runtime_error(
+          _memory.name() +
+          " was published by an incompatible pyfri or FRI version.");
+    if (_memory.size() <
+        sizeof(SharedStateHeader) + header->slot_count * SHARED_STATE_SLOT_SIZE)
+      throw std::runtime_error(_memory.name() + " is truncated.");
+  }
+
+  const std::string &name() const { return _memory.name(); }
+
+  std::size_t slot_count() const { return _header()->slot_count; }
+
+  // Number of samples published so far
+  std::uint64_t published() const {
+    return _header()->published.load(std::memory_order_acquire);
+  }
+
+  // Copy sample `index`, fails if it was not published yet, has been
+  // overwritten or is being overwritten
+  bool read(std::uint64_t index, LBRStateSnapshot &snapshot) const {
+    const SharedStateSlot *slot = _slot(index % slot_count());
+    const std::uint64_t expected = 2 * index + 2;
+    if (slot->sequence.load(std::memory_order_acquire) != expected)
+      return false;
+    std::memcpy(&snapshot, &slot->snapshot, sizeof(LBRStateSnapshot));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->sequence.load(std::memory_order_relaxed) == expected;
+  }
+
+  // Copy the most recent sample, returns its index or -1 if none was
+  // published yet
+  long long latest(LBRStateSnapshot &snapshot) const {
+    for (;;) {
+      const std::uint64_t published = this->published();
+      if (published == 0)
+        return -1;
+      // Only fails if the publisher lapped the ring meanwhile, then retry
+      // with the newer sample
+      if (read(published - 1, snapshot))
+        return static_cast<long long>(published - 1);
+    }
+  }
+
+  // Copy up to `count` of the most recent samples, oldest first. Returns the
+  // number copied and the index of the first one.
+  std::size_t history(std::size_t count, LBRStateSnapshot *snapshots,
+                      std::uint64_t &first) const {
+    const std::uint64_t end = published();
+    // The oldest slot may be overwritten by the next sample
+    const std::uint64_t available =
+        std::min<std::uint64_t>(end, slot_count() > 1 ? slot_count() - 1 : 1);
+    if (count > available)
+      count = static_cast<std::size_t>(available);
+
+    first = end - count;
+    std::size_t copied = 0;
+    for (std::uint64_t i = first; i < end; ++i) {
+      if (read(i, snapshots[copied])) {
+        ++copied;
+      } else {
+        // Overwritten while copying, keep only the newer samples
+        copied = 0;
+        first = i + 1;
+      }
+    }
+    return copied;
+  }
+
+private:
+  SharedMemory _memory;
+
+  const SharedStateHeader *_header() const {
+    return static_cast<const SharedStateHeader *>(_memory.data());
+  }
+
+  const SharedStateSlot *_slot(std::size_t i) const {
+    return reinterpret_cast<const SharedStateSlot *>(
+        static_cast<const char *>(_memory.data()) + sizeof(SharedStateHeader) +
+        i * SHARED_STATE_SLOT_SIZE);
+  }
+};
+
+#endif // PYFRI_SHARED_STATE_H
@@ -0,0 +1,287 @@
+#ifndef PYFRI_SIGNAL_FILTERS_H
+#define PYFRI_SIGNAL_FILTERS_H
+
+// Standard library
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Native counterparts of pyfri.tools.filters. A filter processes one sample
+// of a multi-channel signal (e.g. 7 joint torques) per call. The number of
+// channels is fixed by the first sample after construction or reset(), all
+// state is allocated then and laid out channel-contiguous, so the inner
+// loops run across channels and vectorize.
+class SignalFilter {
+
+public:
+  virtual ~SignalFilter() {}
+
+  std::size_t size() const { return _size; }
+
+  // Forget the past samples, the next sample may have a different size
+  void reset() { _size = 0; }
+
+  // Filter sample x into y, both of length n. y may alias x.
+  void filter(const double *x, double *y, std::size_t n) {
+    if (n != _size) {
+      if (_size != 0)
+        throw std::runtime_error("Input array must have shape (" +
+                                 std::to_string(_size) + ",)!");
+      if (n == 0)
+        throw std::runtime_error("Input array must not be empty!");
+      _size = n;
+      _initialize(x);
+      std::copy(x, x + n, y);
+      return;
+    }
+    _filter(x, y);
+  }
+
+protected:
+  SignalFilter() : _size(0) {}
+
+  // Allocate the state for _size channels, starting from sample x
+  virtual void _initialize(const double *x) = 0;
+
+  virtual void _filter(const double *x, double *y) = 0;
+
+  std::size_t _size;
+};
+
+// First order low-pass y += smooth * (x - y), same as ExponentialStateFilter
+class ExponentialFilter : public SignalFilter {
+
+public:
+  ExponentialFilter(double smooth = 0.02) : _smooth(smooth) {
+    if (!(smooth > 0.0 && smooth <= 1.0))
+      throw std::runtime_error("smooth must be in (0, 1]!");
+  }
+
+  double smooth() const { return _smooth; }
+
+protected:
+  void _initialize(const double *x) override { _y.assign(x, x + _size); }
+
+  void _filter(const double *x, double *y) override {
+    double *state = _y.data();
+    for (std::size_t i = 0; i < _size; ++i) {
+      state[i] += _smooth * (x[i] - state[i]);
+      y[i] = state[i];
+    }
+  }
+
+private:
+  double _smooth;
+  std::vector<double> _y;
+};
+
+// Mean over the last window_size samples, same as MovingAverageFilter but
+// O(1) per channel using a running sum over a ring of past samples
+class MovingAverageFilter : public SignalFilter {
+
+public:
+  MovingAverageFilter(std::size_t window_size) : _window_size(window_size) {
+    if (window_size == 0)
+      throw std::runtime_error("window_size must be positive!");
+  }
+
+  std::size_t window_size() const { return _window_size; }
+
+protected:
+  void _initialize(const double *x) override {
+    _ring.assign(_window_size * _size, 0.0);
+    _sum.assign(x, x + _size);
+    std::copy(x, x + _size, _ring.begin());
+    _count = 1;
+    _head = 1 % _window_size;
+    _updates = 0;
+  }
+
+  void _filter(const double *x, double *y) override {
+    double *slot = _ring.data() + _head * _size;
+    double *sum = _sum.data();
+    if (_count == _window_size) {
+      for (std::size_t i = 0; i < _size; ++i)
+        sum[i] += x[i] - slot[i];
+    } else {
+      for (std::size_t i = 0; i < _size; ++i)
+        sum[i] += x[i];
+      ++_count;
+    }
+    std::copy(x, x + _size, slot);
+    _head = _head + 1 == _window_size ? 0 : _head + 1;
+
+    // Recompute the sum once per window so rounding errors cannot build up
+    if (++_updates == _window_size) {
+      _updates = 0;
+      std::fill(_sum.begin(), _sum.end(), 0.0);
+      for (std::size_t k = 0; k < _count; ++k) {
+        const double *past = _ring.data() + k * _size;
+        for (std::size_t i = 0; i < _size; ++i)
+          sum[i] += past[i];
+      }
+    }
+
+    const double scale = 1.0 / _count;
+    for (std::size_t i = 0; i < _size; ++i)
+      y[i] = sum[i] * scale;
+  }
+
+private:
+  std::size_t _window_size;
+  std::vector<double> _ring; // window_size samples of _size channels
+  std::vector<double> _sum;
+  std::size_t _count;   // samples in the ring
+  std::size_t _head;    // slot for the next sample
+  std::size_t _updates; // samples since the sum was last recomputed
+};
+
+// Butterworth low-pass of even order as a cascade of biquads (bilinear
+// transform, transposed direct form II). The state starts at the steady
+// state of the first sample, so there is no start-up transient.
+class ButterworthFilter : public SignalFilter {
+
+public:
+  ButterworthFilter(double cutoff_frequency, double sample_frequency,
+                    unsigned int order = 2)
+      : _cutoff_frequency(cutoff_frequency),
+        _sample_frequency(sample_frequency), _order(order) {
+    if (order == 0 || order % 2 != 0 || order > 16)
+      throw std::runtime_error("order must be even and in [2, 16]!");
+    if (!(cutoff_frequency > 0.0 && cutoff_frequency < 0.5 * sample_frequency))
+      throw std::runtime_error(
+          "cutoff_frequency must be in (0, sample_frequency / 2)!");
+
+    const double pi = 3.14159265358979323846;
+    const double k = std::tan(pi * cutoff_frequency / sample_frequency);
+    for (unsigned int s = 0; s < order / 2; ++s) {
+      // Quality factor of the s-th conjugate pole pair
+      const double q =
+          1.0 / (2.0 * std::cos((2.0 * s + 1.0) * pi / (2.0 * order)));
+      const double norm = 1.0 / (1.0 + k / q + k * k);
+      Section section;
+      section.b0 = k * k * norm;
+      section.b1 = 2.0 * section.b0;
+      section.b2 = section.b0;
+      section.a1 = 2.0 * (k * k - 1.0) * norm;
+      section.a2 = (1.0 - k / q + k * k) * norm;
+      _sections.push_back(section);
+    }
+  }
+
+  double cutoff_frequency() const { return _cutoff_frequency; }
+
+  double sample_frequency() const { return _sample_frequency; }
+
+  unsigned int order() const { return _order; }
+
+protected:
+  void _initialize(const double *x) override {
+    _z1.assign(_sections.size() * _size, 0.0);
+    _z2.assign(_sections.size() * _size, 0.0);
+    // Unity DC gain, so every section outputs x in steady state
+    for (std::size_t s = 0; s < _sections.size(); ++s) {
+      const Section &c = _sections[s];
+      double *z1 = _z1.data() + s * _size;
+      double *z2 = _z2.data() + s * _size;
+      for (std::size_t i = 0; i < _size; ++i) {
+        z2[i] = (c.b2 - c.a2) * x[i];
+        z1[i] = (c.b1 - c.a1) * x[i] + z2[i];
+      }
+    }
+  }
+
+  void _filter(const double *x, double *y) override {
+    if (y != x)
+      std::copy(x, x + _size, y);
+    for (std::size_t s = 0; s < _sections.size(); ++s) {
+      const Section c = _sections[s];
+      double *z1 = _z1.data() + s * _size;
+      double *z2 = _z2.data() + s * _size;
+      for (std::size_t i = 0; i < _size; ++i) {
+        const double in = y[i];
+        const double out = c.b0 * in + z1[i];
+        z1[i] = c.b1 * in - c.a1 * out + z2[i];
+        z2[i] = c.b2 * in - c.a2 * out;
+        y[i] = out;
+      }
+    }
+  }
+
+private:
+  struct Section {
+    double b0, b1, b2, a1, a2;
+  };
+
+  double _cutoff_frequency;
+  double _sample_frequency;
+  unsigned int _order;
+  std::vector<Section> _sections;
+  std::vector<double> _z1; // sections x channels
+  std::vector<double> _z2;
+};
+
+// Median over the last window_size samples. Each channel keeps its window
+// sorted, so an update moves at most window_size values.
+class MedianFilter : public SignalFilter {
+
+public:
+  MedianFilter(std::size_t window_size) : _window_size(window_size) {
+    if (window_size == 0)
+      throw std::runtime_error("window_size must be positive!");
+  }
+
+  std::size_t window_size() const { return _window_size; }
+
+protected:
+  void _initialize(const double *x) override {
+    _ring.assign(_window_size * _size, 0.0);
+    _sorted.assign(_window_size * _size, 0.0);
+    for (std::size_t i = 0; i < _size; ++i) {
+      _ring[i] = x[i];
+      _sorted[i * _window_size] = x[i];
+    }
+    _count = 1;
+    _head = 1 % _window_size;
+  }
+
+  void _filter(const double *x, double *y) override {
+    double *slot = _ring.data() + _head * _size;
+    for (std::size_t i = 0; i < _size; ++i) {
+      const double value = x[i];
+      double *sorted = _sorted.data() + i * _window_size;
+      double *end = sorted + _count;
+
+      // Remove the oldest value once the window is full
+      if (_count == _window_size) {
+        double *old = std::lower_bound(sorted, end, slot[i]);
+        std::copy(old + 1, end, old);
+        --end;
+      }
+
+      double *position = std::upper_bound(sorted, end, value);
+      std::copy_backward(position, end, end + 1);
+      *position = value;
+
+      const std::size_t n = _count == _window_size ? _count : _count + 1;
+      y[i] = n % 2 == 1 ? sorted[n / 2]
+                        : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+      slot[i] = value;
+    }
+    if (_count < _window_size)
+      ++_count;
+    _head = _head + 1 == _window_size ? 0 : _head + 1;
+  }
+
+private:
+  std::size_t _window_size;
+  std::vector<double> _ring;   // window_size samples of _size channels
+  std::vector<double> _sorted; // per channel, the window in sorted order
+  std::size_t _count;          // samples in the window
+  std::size_t _head;           // slot for the next sample
+};
+
+#endif // PYFRI_SIGNAL_FILTERS_H
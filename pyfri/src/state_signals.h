@@ -0,0 +1,237 @@
+#ifndef PYFRI_STATE_SIGNALS_H
+#define PYFRI_STATE_SIGNALS_H
+
+// Standard library
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <tuple>
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friLBRCommand.h"
+#include "friLBRState.h"
+
+#include "pose_conversions.h"
+
+inline bool alwaysAvailable(const KUKA::FRI::LBRState &) { return true; }
+
+// The interpolator values are only sent while commanding, otherwise their
+// getters throw a KUKA::FRI::FRIException
+inline bool interpolatorAvailable(const KUKA::FRI::LBRState &state) {
+  const KUKA::FRI::ESessionState session = state.getSessionState();
+  return session == KUKA::FRI::ESessionState::COMMANDING_WAIT ||
+         session == KUKA::FRI::ESessionState::COMMANDING_ACTIVE;
+}
+
+// Array signal of LBRState, read through Getter whenever Available(state).
+// Size is a compile-time constant, so the copies below are unrolled for every
+// signal and SDK version.
+template <const double *(KUKA::FRI::LBRState::*Getter)() const,
+          unsigned int Size,
+          bool (*Available)(const KUKA::FRI::LBRState &) = &alwaysAvailable>
+struct StateSignal {
+  static constexpr unsigned int SIZE = Size;
+
+  static bool available(const KUKA::FRI::LBRState &state) {
+    return Available(state);
+  }
+
+  static const double *data(const KUKA::FRI::LBRState &state) {
+    return (state.*Getter)();
+  }
+
+  // Copy with conversion, e.g. into the float32 arrays of the legacy getters
+  template <typename T>
+  static void copy(const KUKA::FRI::LBRState &state, T *out) {
+    const double *values = data(state);
+    for (unsigned int i = 0; i < Size; ++i)
+      out[i] = static_cast<T>(values[i]);
+  }
+
+  // Copy, or NaN while the signal is not available, for the records that are
+  // taken in every session state
+  template <typename T>
+  static void copyAvailable(const KUKA::FRI::LBRState &state, T *out) {
+    if (available(state))
+      copy(state, out);
+    else
+      std::fill_n(out, Size, std::numeric_limits<T>::quiet_NaN());
+  }
+
+  // Copy into the 8-byte words of a recorded sample, NaN while the signal is
+  // not available, e.g. for telemetry outside commanding
+  static void copyWords(const KUKA::FRI::LBRState &state, void *words) {
+    if (available(state))
+      std::memcpy(words, data(state), Size * sizeof(double));
+    else
+      std::fill_n(static_cast<double *>(words), Size,
+                  std::numeric_limits<double>::quiet_NaN());
+  }
+};
+
+// The signals, each with
+//   NAME         the getter's name without "get", e.g. getNAME() and
+//                getNAMEView() in Python
+//   DOC          docstring of the getters
+//   RECORD_NAME  name of the recorded signal, its columns are named by
+//                column(RECORD_NAME, i)
+//   FLOAT32      whether getNAME() without out returns float32, as the
+//                original bindings did
+//   POSE         whether it is a [x, y, z, qw, qx, qy, qz] pose, which also
+//                gets getNAMEAsMatrix()
+
+struct JointSignalTraits {
+  static std::string column(const std::string &name, unsigned int i) {
+    return name + std::to_string(i + 1);
+  }
+
+  static constexpr bool FLOAT32 = true;
+  static constexpr bool POSE = false;
+};
+
+struct MeasuredJointPositionSignal
+    : StateSignal<&KUKA::FRI::LBRState::getMeasuredJointPosition,
+                  KUKA::FRI::LBRState::NUMBER_OF_JOINTS>,
+      JointSignalTraits {
+  static constexpr const char *NAME = "MeasuredJointPosition";
+  static constexpr const char *DOC = "Measured joint position (rad).";
+  static constexpr const char *RECORD_NAME = "mp";
+};
+
+struct MeasuredTorqueSignal
+    : StateSignal<&KUKA::FRI::LBRState::getMeasuredTorque,
+                  KUKA::FRI::LBRState::NUMBER_OF_JOINTS>,
+      JointSignalTraits {
+  static constexpr const char *NAME = "MeasuredTorque";
+  static constexpr const char *DOC = "Measured joint torque (Nm).";
+  static constexpr const char *RECORD_NAME = "mt";
+};
+
+struct CommandedTorqueSignal
+    : StateSignal<&KUKA::FRI::LBRState::getCommandedTorque,
+                  KUKA::FRI::LBRState::NUMBER_OF_JOINTS>,
+      JointSignalTraits {
+  static constexpr const char *NAME = "CommandedTorque";
+  static constexpr const char *DOC = "Last commanded joint torque (Nm).";
+  static constexpr const char *RECORD_NAME = "ct";
+};
+
+struct ExternalTorqueSignal
+    : StateSignal<&KUKA::FRI::LBRState::getExternalTorque,
+                  KUKA::FRI::LBRState::NUMBER_OF_JOINTS>,
+      JointSignalTraits {
+  static constexpr const char *NAME = "ExternalTorque";
+  static constexpr const char *DOC = "Estimated external joint torque (Nm).";
+  static constexpr const char *RECORD_NAME = "et";
+};
+
+struct IpoJointPositionSignal
+    : StateSignal<&KUKA::FRI::LBRState::getIpoJointPosition,
+                  KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+                  &interpolatorAvailable>,
+      JointSignalTraits {
+  static constexpr const char *NAME = "IpoJointPosition";
+  static constexpr const char *DOC =
+      "Joint position of the controller's interpolator (rad).";
+  static constexpr const char *RECORD_NAME = "ip";
+};
+
+#if FRI_CLIENT_VERSION_MAJOR == 1
+struct CommandedJointPositionSignal
+    : StateSignal<&KUKA::FRI::LBRState::getCommandedJointPosition,
+                  KUKA::FRI::LBRState::NUMBER_OF_JOINTS>,
+      JointSignalTraits {
+  static constexpr const char *NAME = "CommandedJointPosition";
+  static constexpr const char *DOC = "Last commanded joint position (rad).";
+  static constexpr const char *RECORD_NAME = "cp";
+};
+#elif FRI_CLIENT_VERSION_MAJOR == 2
+struct PoseSignalTraits {
+  static std::string column(const std::string &name, unsigned int i) {
+    static const char *const suffixes[QUATERNION_POSE_SIZE] = {
+        "_x", "_y", "_z", "_qw", "_qx", "_qy", "_qz"};
+    return name + suffixes[i];
+  }
+
+  static constexpr bool POSE = true;
+};
+
+struct MeasuredCartesianPoseSignal
+    : StateSignal<&KUKA::FRI::LBRState::getMeasuredCartesianPose,
+                  QUATERNION_POSE_SIZE>,
+      PoseSignalTraits {
+  static constexpr const char *NAME = "MeasuredCartesianPose";
+  static constexpr const char *DOC =
+      "Measured pose [x, y, z, qw, qx, qy, qz] of the flange or tool.";
+  static constexpr const char *RECORD_NAME = "pose";
+  static constexpr bool FLOAT32 = true;
+};
+
+// The interpolator pose is only sent in the Cartesian overlay
+inline bool cartesianInterpolatorAvailable(const KUKA::FRI::LBRState &state) {
+  return interpolatorAvailable(state) &&
+         state.getOverlayType() == KUKA::FRI::EOverlayType::CARTESIAN;
+}
+
+struct IpoCartesianPoseSignal
+    : StateSignal<&KUKA::FRI::LBRState::getIpoCartesianPose,
+                  QUATERNION_POSE_SIZE, &cartesianInterpolatorAvailable>,
+      PoseSignalTraits {
+  static constexpr const char *NAME = "IpoCartesianPose";
+  static constexpr const char *DOC =
+      "Interpolator pose [x, y, z, qw, qx, qy, qz], only available in the "
+      "Cartesian overlay.";
+  static constexpr const char *RECORD_NAME = "ipo_pose";
+  static constexpr bool FLOAT32 = false;
+};
+#endif
+
+using StateSignals = std::tuple<
+    MeasuredJointPositionSignal, MeasuredTorqueSignal, CommandedTorqueSignal,
+    ExternalTorqueSignal, IpoJointPositionSignal,
+#if FRI_CLIENT_VERSION_MAJOR == 1
+    CommandedJointPositionSignal
+#elif FRI_CLIENT_VERSION_MAJOR == 2
+    MeasuredCartesianPoseSignal, IpoCartesianPoseSignal
+#endif
+    >;
+
+// Array command of LBRCommand, written through Setter
+template <void (KUKA::FRI::LBRCommand::*Setter)(const double *),
+          unsigned int Size>
+struct CommandSignal {
+  static constexpr unsigned int SIZE = Size;
+
+  static void write(KUKA::FRI::LBRCommand &command, const double *values) {
+    (command.*Setter)(values);
+  }
+};
+
+struct JointPositionCommand
+    : CommandSignal<&KUKA::FRI::LBRCommand::setJointPosition,
+                    KUKA::FRI::LBRState::NUMBER_OF_JOINTS> {
+  static constexpr const char *NAME = "JointPosition";
+};
+
+struct WrenchCommand : CommandSignal<&KUKA::FRI::LBRCommand::setWrench, 6> {
+  static constexpr const char *NAME = "Wrench"; // [F_x, F_y, F_z, A, B, C]
+};
+
+struct TorqueCommand
+    : CommandSignal<&KUKA::FRI::LBRCommand::setTorque,
+                    KUKA::FRI::LBRState::NUMBER_OF_JOINTS> {
+  static constexpr const char *NAME = "Torque";
+};
+
+// The Cartesian pose setters take an optional redundancy value and are bound
+// separately
+using CommandSignals =
+    std::tuple<JointPositionCommand, WrenchCommand, TorqueCommand>;
+
+// Call f(Signal()) for every signal of a table
+template <typename Signals, typename F> void forEachSignal(F &&f) {
+  std::apply([&f](auto... signal) { (f(signal), ...); }, Signals());
+}
+
+#endif // PYFRI_STATE_SIGNALS_H
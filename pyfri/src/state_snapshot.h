@@ -0,0 +1,130 @@
+#ifndef PYFRI_STATE_SNAPSHOT_H
+#define PYFRI_STATE_SNAPSHOT_H
+
+// Standard library
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// KUKA FRI-Client-SDK_Cpp
+#include "friLBRState.h"
+
+#include "state_signals.h"
+
+// Everything LBRState reports in one fixed-layout record. Exposed to Python
+// as a NumPy structured dtype so that a whole cycle's state can be read with
+// a single call. The interpolator position is only sent while commanding and
+// NaN in the other session states.
+struct LBRStateSnapshot {
+  double sample_time;
+  double tracking_performance;
+  double measured_joint_position[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+  double measured_torque[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+  double commanded_torque[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+  double external_torque[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+  double ipo_joint_position[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+#if FRI_CLIENT_VERSION_MAJOR == 1
+  double commanded_joint_position[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
+#elif FRI_CLIENT_VERSION_MAJOR == 2
+  double measured_cartesian_pose[QUATERNION_POSE_SIZE]; // x, y, z, qw, ...
+  double measured_redundancy_value;
+#endif
+  std::int64_t timestamp_sec;
+  std::int64_t timestamp_nanosec;
+  std::int32_t session_state;
+  std::int32_t connection_quality;
+  std::int32_t safety_state;
+  std::int32_t operation_mode;
+  std::int32_t drive_state;
+  std::int32_t client_command_mode;
+  std::int32_t overlay_type;
+  std::int32_t control_mode;
+};
+
+inline void takeSnapshot(const KUKA::FRI::LBRState &state,
+                         LBRStateSnapshot &snapshot) {
+  snapshot.sample_time = state.getSampleTime();
+  snapshot.tracking_performance = state.getTrackingPerformance();
+  MeasuredJointPositionSignal::copy(state, snapshot.measured_joint_position);
+  MeasuredTorqueSignal::copy(state, snapshot.measured_torque);
+  CommandedTorqueSignal::copy(state, snapshot.commanded_torque);
+  ExternalTorqueSignal::copy(state, snapshot.external_torque);
+  IpoJointPositionSignal::copyAvailable(state, snapshot.ipo_joint_position);
+#if FRI_CLIENT_VERSION_MAJOR == 1
+  CommandedJointPositionSignal::copy(state, snapshot.commanded_joint_position);
+#elif FRI_CLIENT_VERSION_MAJOR == 2
+  MeasuredCartesianPoseSignal::copy(state, snapshot.measured_cartesian_pose);
+  snapshot.measured_redundancy_value = state.getMeasuredRedundancyValue();
+#endif
+  snapshot.timestamp_sec = state.getTimestampSec();
+  snapshot.timestamp_nanosec = state.getTimestampNanoSec();
+  snapshot.session_state = state.getSessionState();
+  snapshot.connection_quality = state.getConnectionQuality();
+  snapshot.safety_state = state.getSafetyState();
+  snapshot.operation_mode = state.getOperationMode();
+  snapshot.drive_state = state.getDriveState();
+  snapshot.client_command_mode = state.getClientCommandMode();
+  snapshot.overlay_type = state.getOverlayType();
+  snapshot.control_mode = state.getControlMode();
+}
+
+// Snapshot record extended by IO values. The IO names are configured on the
+// controller, so they are given once up front and the values are appended
+// after the LBRStateSnapshot fields: analog IOs as float64, digital IOs as
+// uint64, then boolean IOs as one byte each.
+class SnapshotLayout {
+
+public:
+  SnapshotLayout(std::vector<std::string> boolean_io,
+                 std::vector<std::string> digital_io,
+                 std::vector<std::string> analog_io)
+      : _boolean_io(std::move(boolean_io)), _digital_io(std::move(digital_io)),
+        _analog_io(std::move(analog_io)) {}
+
+  const std::vector<std::string> &boolean_io() const { return _boolean_io; }
+
+  const std::vector<std::string> &digital_io() const { return _digital_io; }
+
+  const std::vector<std::string> &analog_io() const { return _analog_io; }
+
+  std::size_t analog_offset() const { return sizeof(LBRStateSnapshot); }
+
+  std::size_t digital_offset() const {
+    return analog_offset() + _analog_io.size() * sizeof(double);
+  }
+
+  std::size_t boolean_offset() const {
+    return digital_offset() + _digital_io.size() * sizeof(std::uint64_t);
+  }
+
+  // Record size, padded to keep consecutive records 8-byte aligned
+  std::size_t itemsize() const {
+    const std::size_t size = boolean_offset() + _boolean_io.size();
+    return (size + 7) / 8 * 8;
+  }
+
+  void fill(const KUKA::FRI::LBRState &state, char *record) const {
+    takeSnapshot(state, *reinterpret_cast<LBRStateSnapshot *>(record));
+
+    double *analog = reinterpret_cast<double *>(record + analog_offset());
+    for (std::size_t i = 0; i < _analog_io.size(); ++i)
+      analog[i] = state.getAnalogIOValue(_analog_io[i].c_str());
+
+    std::uint64_t *digital =
+        reinterpret_cast<std::uint64_t *>(record + digital_offset());
+    for (std::size_t i = 0; i < _digital_io.size(); ++i)
+      digital[i] = state.getDigitalIOValue(_digital_io[i].c_str());
+
+    bool *boolean = reinterpret_cast<bool *>(record + boolean_offset());
+    for (std::size_t i = 0; i < _boolean_io.size(); ++i)
+      boolean[i] = state.getBooleanIOValue(_boolean_io[i].c_str());
+  }
+
+private:
+  std::vector<std::string> _boolean_io;
+  std::vector<std::string> _digital_io;
+  std::vector<std::string> _analog_io;
+};
+
+#endif // PYFRI_STATE_SNAPSHOT_H
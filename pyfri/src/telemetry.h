@@ -0,0 +1,293 @@
+#ifndef PYFRI_TELEMETRY_H
+#define PYFRI_TELEMETRY_H
+
+// Standard library
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include "data_recorder.h"
+
+// Transport of the telemetry stream
+enum class TelemetryProtocol { UDP, TCP };
+
+// Streams recorded samples to a remote consumer. It runs on the background
+// thread of a DataRecorder, so the FRI thread only pushes samples into the
+// recorder's ring buffer. The messages use the recording schema, all values
+// are little-endian.
+//
+// Schema message, sent first:
+//
+//   offset  size  content
+//   0       8     magic "PYFRISCH"
+//   8       4     format version (uint32)
+//   12      4     number of columns C (uint32)
+//   16      32*C  column descriptors as in BinaryRecordWriter
+//
+// Batch message, batch_size samples (fewer in the last one):
+//
+//   offset  size  content
+//   0       8     magic "PYFRITLM"
+//   8       4     format version (uint32)
+//   12      4     number of columns C (uint32)
+//   16      8     sequence number of the batch (uint64), gaps are lost batches
+//   24      4     number of samples N (uint32)
+//   28      4     reserved
+//   32      8*C*N samples, C 8-byte words each (int64 or float64)
+//
+// Over UDP every message is one datagram and the schema is repeated every
+// SCHEMA_INTERVAL batches for consumers that join late. Over TCP every message
+// is preceded by its size in bytes (uint32), and a send waits at most
+// SEND_TIMEOUT_MS for a slow consumer. A failed or timed out send is counted
+// and the batch dropped. Over TCP a message that was only partly sent breaks
+// the framing, so the stream is closed and all later batches fail.
+class TelemetryWriter : public RecordWriter {
+
+public:
+  static constexpr char SCHEMA_MAGIC[8] = {'P', 'Y', 'F', 'R',
+                                           'I', 'S', 'C', 'H'};
+  static constexpr char BATCH_MAGIC[8] = {'P', 'Y', 'F', 'R',
+                                          'I', 'T', 'L', 'M'};
+  static constexpr std::uint32_t VERSION = 1;
+  static constexpr std::size_t BATCH_HEADER_SIZE = 32;
+  static constexpr std::size_t SCHEMA_INTERVAL = 64;
+  static constexpr int SEND_TIMEOUT_MS = 50;
+
+  // Largest UDP payload over IPv4
+  static constexpr std::size_t MAX_DATAGRAM_SIZE = 65507;
+
+  TelemetryWriter(const std::string &host, int port, TelemetryProtocol protocol,
+                  const std::vector<RecordColumn> &columns,
+                  std::size_t batch_size)
+      : _protocol(protocol), _width(columns.size()), _batch_size(batch_size),
+        _socket(-1), _staged(0), _sequence(0), _sent(0), _failed(0) {
+#ifdef _WIN32
+    throw std::runtime_error("Telemetry is only supported on POSIX systems.");
+#else
+    if (batch_size == 0)
+      throw std::runtime_error("batch_size must be positive!");
+    const std::size_t size =
+        BATCH_HEADER_SIZE + batch_size * _width * sizeof(std::uint64_t);
+    if (protocol == TelemetryProtocol::UDP && size > MAX_DATAGRAM_SIZE)
+      throw std::runtime_error("A batch of " + std::to_string(batch_size) +
+                               " samples does not fit into a datagram.");
+
+    _schema = _schemaMessage(columns);
+    _message.resize(size);
+    std::memcpy(_message.data(), BATCH_MAGIC, sizeof(BATCH_MAGIC));
+    const std::uint32_t version = VERSION, num_columns = _width;
+    std::memcpy(_message.data() + 8, &version, sizeof(version));
+    std::memcpy(_message.data() + 12, &num_columns, sizeof(num_columns));
+
+    _connect(host, port);
+    if (!_send(_schema) && protocol == TelemetryProtocol::TCP) {
+      const int error = errno;
+      if (_socket >= 0)
+        ::close(_socket);
+      throw std::runtime_error("Failed to send the telemetry schema: " +
+                               std::string(std::strerror(error)));
+    }
+#endif
+  }
+
+  ~TelemetryWriter() { close(); }
+
+  TelemetryWriter(const TelemetryWriter &) = delete;
+  TelemetryWriter &operator=(const TelemetryWriter &) = delete;
+
+  // Batches sent, and dropped because the send failed
+  unsigned long long sent_batches() const { return _sent; }
+
+  unsigned long long failed_batches() const { return _failed; }
+
+  void write(const std::uint64_t *rows, std::size_t n) override {
+    while (n > 0) {
+      const std::size_t count = std::min(n, _batch_size - _staged);
+      std::memcpy(_samples() + _staged * _width, rows,
+                  count * _width * sizeof(std::uint64_t));
+      _staged += count;
+      rows += count * _width;
+      n -= count;
+      if (_staged == _batch_size)
+        _sendBatch();
+    }
+  }
+
+  void close() override {
+#ifndef _WIN32
+    if (_socket < 0)
+      return;
+    if (_staged > 0)
+      _sendBatch();
+    ::close(_socket);
+    _socket = -1;
+#endif
+  }
+
+private:
+  TelemetryProtocol _protocol;
+  std::size_t _width;
+  std::size_t _batch_size;
+  int _socket;
+  std::vector<char> _schema;
+  std::vector<char> _message; // header and staged samples of the next batch
+  std::size_t _staged;
+  std::uint64_t _sequence;
+  std::atomic<unsigned long long> _sent;
+  std::atomic<unsigned long long> _failed;
+
+  std::uint64_t *_samples() {
+    return reinterpret_cast<std::uint64_t *>(_message.data() +
+                                             BATCH_HEADER_SIZE);
+  }
+
+  static std::vector<char>
+  _schemaMessage(const std::vector<RecordColumn> &columns) {
+    constexpr std::size_t NAME_SIZE = BinaryRecordWriter::NAME_SIZE;
+    std::vector<char> schema(16 + columns.size() * (NAME_SIZE + 4), 0);
+    const std::uint32_t version = VERSION, num_columns = columns.size();
+    std::memcpy(schema.data(), SCHEMA_MAGIC, sizeof(SCHEMA_MAGIC));
+    std::memcpy(schema.data() + 8, &version, sizeof(version));
+    std::memcpy(schema.data() + 12, &num_columns, sizeof(num_columns));
+    char *descriptor = schema.data() + 16;
+    for (const RecordColumn &column : columns) {
+      if (column.name.size() >= NAME_SIZE)
+        throw std::runtime_error("Column name " + column.name +
+                                 " is too long.");
+      const std::uint32_t type = static_cast<std::uint32_t>(column.type);
+      std::memcpy(descriptor, column.name.data(), column.name.size());
+      std::memcpy(descriptor + NAME_SIZE, &type, sizeof(type));
+      descriptor += NAME_SIZE + 4;
+    }
+    return schema;
+  }
+
+  void _sendBatch() {
+    const std::uint32_t rows = _staged;
+    std::memcpy(_message.data() + 16, &_sequence, sizeof(_sequence));
+    std::memcpy(_message.data() + 24, &rows, sizeof(rows));
+    const std::size_t size =
+        BATCH_HEADER_SIZE + _staged * _width * sizeof(std::uint64_t);
+    if (_send(_message.data(), size))
+      _sent++;
+    else
+      _failed++;
+    _sequence++;
+    _staged = 0;
+
+    if (_protocol == TelemetryProtocol::UDP &&
+        _sequence % SCHEMA_INTERVAL == 0)
+      _send(_schema);
+  }
+
+#ifndef _WIN32
+  void _connect(const std::string &host, int port) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype =
+        _protocol == TelemetryProtocol::UDP ? SOCK_DGRAM : SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    const int resolved = ::getaddrinfo(host.c_str(),
+                                       std::to_string(port).c_str(), &hints,
+                                       &addresses);
+    if (resolved != 0)
+      throw std::runtime_error("Failed to resolve " + host + ": " +
+                               ::gai_strerror(resolved));
+
+    int error = 0;
+    for (addrinfo *address = addresses; address; address = address->ai_next) {
+      _socket = ::socket(address->ai_family, address->ai_socktype,
+                         address->ai_protocol);
+      if (_socket < 0) {
+        error = errno;
+        continue;
+      }
+      // A UDP socket is connected to skip the route lookup of every send
+      if (::connect(_socket, address->ai_addr, address->ai_addrlen) == 0)
+        break;
+      error = errno;
+      ::close(_socket);
+      _socket = -1;
+    }
+    ::freeaddrinfo(addresses);
+    if (_socket < 0)
+      throw std::runtime_error("Failed to connect to " + host + ":" +
+                               std::to_string(port) + ": " +
+                               std::strerror(error));
+
+    if (_protocol == TelemetryProtocol::TCP) {
+      const int enable = 1;
+      ::setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, &enable,
+                   sizeof(enable));
+      // The drain thread must keep up with the ring buffer
+      timeval timeout = {};
+      timeout.tv_sec = SEND_TIMEOUT_MS / 1000;
+      timeout.tv_usec = SEND_TIMEOUT_MS % 1000 * 1000;
+      ::setsockopt(_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                   sizeof(timeout));
+    }
+  }
+#endif
+
+  bool _send(const std::vector<char> &message) {
+    return _send(message.data(), message.size());
+  }
+
+  bool _send(const char *data, std::size_t size) {
+#ifdef _WIN32
+    return false;
+#else
+    if (_socket < 0)
+      return false;
+    if (_protocol == TelemetryProtocol::UDP)
+      return ::send(_socket, data, size, 0) == static_cast<ssize_t>(size);
+
+    const std::uint32_t length = size;
+    std::size_t sent = 0;
+    const bool complete =
+        _sendAll(reinterpret_cast<const char *>(&length), sizeof(length),
+                 sent) &&
+        _sendAll(data, size, sent);
+    if (!complete && sent > 0) {
+      ::close(_socket);
+      _socket = -1;
+    }
+    return complete;
+#endif
+  }
+
+#ifndef _WIN32
+  // Fails with EAGAIN once SO_SNDTIMEO expires, `sent` counts the bytes of
+  // the message that went out
+  bool _sendAll(const char *data, std::size_t size, std::size_t &sent) {
+    while (size > 0) {
+      const ssize_t n = ::send(_socket, data, size, MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      data += n;
+      size -= n;
+      sent += n;
+    }
+    return true;
+  }
+#endif
+};
+
+#endif // PYFRI_TELEMETRY_H
@@ -1,14 +1,22 @@
 // Standard library
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <thread>
+#include <type_traits>
 
 // pybind: https://pybind11.readthedocs.io/en/stable/
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 
 // KUKA FRI-Client-SDK_Cpp (using version hosted at:
 // https://github.com/cmower/FRI-Client-SDK_Cpp)
@@ -17,6 +25,28 @@
 #include "friLBRClient.h"
 #include "friUdpConnection.h"
 
+// pyfri
+#include "admittance_controller.h"
+#include "batch_processing.h"
+#include "command_deadline.h"
+#include "connections.h"
+#include "cycle_statistics.h"
+#include "data_recorder.h"
+#include "event_poller.h"
+#include "joint_state_estimator.h"
+#include "kinematics.h"
+#include "mailbox.h"
+#include "motion_generators.h"
+#include "native_controllers.h"
+#include "pose_conversions.h"
+#include "pseudo_inverse.h"
+#include "realtime_thread.h"
+#include "shared_state.h"
+#include "signal_filters.h"
+#include "state_signals.h"
+#include "state_snapshot.h"
+#include "telemetry.h"
+
 // Function for returning the current time
 long long getCurrentTimeInNanoseconds() {
   using namespace std::chrono;
@@ -31,173 +61,1011 @@ long long getCurrentTimeInNanoseconds() {
   return duration.count();
 }
 
-// Make LBRClient a Python abstract class
+// Make LBRClient a Python abstract class. If a native controller is set, the
+// callbacks run it directly and only onStateChange is forwarded to Python.
+// The callbacks are invoked from step() with the GIL released, the override
+// macros re-acquire it when dispatching to Python. With a CommandDeadline
+// the Python waitForCommand and command run on its worker thread.
 class PyLBRClient : public KUKA::FRI::LBRClient {
 
   using KUKA::FRI::LBRClient::LBRClient;
 
 public:
+  ~PyLBRClient() { set_command_deadline(nullptr); }
+
+  void set_controller(std::shared_ptr<NativeController> controller) {
+    _checkForeground("set_controller");
+    _controller = std::move(controller);
+  }
+
+  std::shared_ptr<NativeController> controller() const { return _controller; }
+
+  // Estimator updated from every state packet before the callbacks run
+  void set_state_estimator(std::shared_ptr<JointStateEstimator> estimator) {
+    _checkForeground("set_state_estimator");
+    _estimator = std::move(estimator);
+  }
+
+  std::shared_ptr<JointStateEstimator> state_estimator() const {
+    return _estimator;
+  }
+
+  // Timing of the monitor/waitForCommand/command callback of the last step
+  CallbackTime &callback_time() { return _callback_time; }
+
+  // nullptr removes the deadline. Waits for a late callback to return, with
+  // the GIL released if held.
+  void set_command_deadline(std::unique_ptr<CommandDeadline> deadline) {
+    std::optional<pybind11::gil_scoped_release> release;
+    if (PyGILState_Check())
+      release.emplace();
+    _deadline = std::move(deadline);
+  }
+
+  const CommandDeadline *command_deadline() const { return _deadline.get(); }
+
+  // Set by the ClientApplication while its background loop steps the client,
+  // the callbacks then use the controller and estimator on that thread
+  void set_background(bool background) { _background = background; }
+
+  // Whether the estimator restarts with the next session after IDLE, set by
+  // the ClientApplication before it steps the client. Kept warm by default.
+  void set_reset_estimator(bool reset) { _reset_estimator = reset; }
+
   void onStateChange(KUKA::FRI::ESessionState oldState,
                      KUKA::FRI::ESessionState newState) override {
+    // Packets stop while IDLE, so the estimate may restart
+    if (_estimator && _reset_estimator &&
+        oldState == KUKA::FRI::ESessionState::IDLE)
+      _estimator->reset();
+    if (_deadline && newState == KUKA::FRI::ESessionState::COMMANDING_WAIT)
+      _deadline->restart();
+    if (_controller) {
+      _controller->onStateChange(robotState(), oldState, newState);
+      PYBIND11_OVERRIDE(void, LBRClient, onStateChange, oldState, newState);
+    }
     PYBIND11_OVERRIDE_PURE(void, LBRClient, onStateChange, oldState, newState);
   }
 
-  void monitor() override { PYBIND11_OVERRIDE_PURE(void, LBRClient, monitor); }
+  void monitor() override {
+    CallbackTimer timer(_callback_time);
+    if (_estimator)
+      _estimator->update(robotState());
+    if (_controller) {
+      _controller->monitor(robotState());
+      return;
+    }
+    PYBIND11_OVERRIDE_PURE(void, LBRClient, monitor);
+  }
 
   void waitForCommand() override {
+    CallbackTimer timer(_callback_time);
+    if (_estimator)
+      _estimator->update(robotState());
+    if (_controller) {
+      _controller->waitForCommand(robotState(), robotCommand());
+      return;
+    }
+    if (_deadline) {
+      _runWithDeadline([this] { _pythonWaitForCommand(); });
+      return;
+    }
     PYBIND11_OVERRIDE_PURE(void, LBRClient, waitForCommand);
   }
 
-  void command() override { PYBIND11_OVERRIDE_PURE(void, LBRClient, command); }
+  void command() override {
+    CallbackTimer timer(_callback_time);
+    if (_estimator)
+      _estimator->update(robotState());
+    if (_controller) {
+      _controller->command(robotState(), robotCommand());
+      return;
+    }
+    if (_deadline) {
+      _runWithDeadline([this] { _pythonCommand(); });
+      return;
+    }
+    PYBIND11_OVERRIDE_PURE(void, LBRClient, command);
+  }
+
+private:
+  std::shared_ptr<NativeController> _controller;
+  std::shared_ptr<JointStateEstimator> _estimator;
+  std::unique_ptr<CommandDeadline> _deadline;
+  CallbackTime _callback_time;
+  std::atomic<bool> _background{false};
+  bool _reset_estimator = false;
+
+  void _checkForeground(const char *name) const {
+    if (_background)
+      throw std::runtime_error(std::string(name) +
+                               "() cannot be called while the background "
+                               "loop is running.");
+  }
+
+  template <typename F> void _runWithDeadline(F callback) {
+    // The worker needs the GIL, e.g. with MultiClientApplication(...,
+    // release_gil=False)
+    std::optional<pybind11::gil_scoped_release> release;
+    if (PyGILState_Check())
+      release.emplace();
+    _deadline->run(callback, robotState(), robotCommand());
+  }
+
+  // Dispatch to Python on the worker thread of the deadline
+  void _pythonWaitForCommand() {
+    PYBIND11_OVERRIDE_PURE_NAME(void, LBRClient, "waitForCommand",
+                                waitForCommand);
+  }
+
+  void _pythonCommand() {
+    PYBIND11_OVERRIDE_PURE_NAME(void, LBRClient, "command", command);
+  }
+};
+
+// Raised by ClientApplication.step(timeout_ms) when no packet arrived in time
+class StepTimeout : public std::runtime_error {
+  using std::runtime_error::runtime_error;
 };
 
-// Wrapper for ClientApplication (does not make sense for the user to
-// instantiate UdpConnection on the Python side).
+// Wrapper for ClientApplication. Talks to the controller through a
+// SocketConnection (UdpConnection on Windows) unless another connection,
+// e.g. a ReplayConnection, is given.
 class PyClientApplication {
 
 public:
-  PyClientApplication(PyLBRClient &client)
-      : _record_index(0), _collect_data(false), _client(client) {
-    _app = std::make_unique<KUKA::FRI::ClientApplication>(_connection, client);
+  // How often the background loop checks for stop_background() while no
+  // packets arrive
+  static constexpr int BACKGROUND_POLL_MS = 100;
+
+  PyClientApplication(
+      PyLBRClient &client,
+      std::shared_ptr<KUKA::FRI::IConnection> connection = nullptr)
+      : _client(client), _connection(std::move(connection)), _port(-1),
+        _has_state(false), _running(false), _across_sessions(false) {
+    if (!_connection) {
+#ifdef _WIN32
+      _connection = std::make_shared<KUKA::FRI::UdpConnection>();
+#else
+      _connection = std::make_shared<SocketConnection>();
+#endif
+    }
+    _app = std::make_unique<KUKA::FRI::ClientApplication>(*_connection, client);
+    _timestamped =
+        dynamic_cast<const TimestampedConnection *>(_connection.get());
+  }
+
+  ~PyClientApplication() {
+    if (_thread.joinable()) {
+      pybind11::gil_scoped_release release;
+      _running = false;
+      _thread.join();
+      _client.set_background(false);
+    }
+  }
+
+  void collect_data(std::string file_name,
+                    RecordingFormat format = RecordingFormat::CSV,
+                    const std::vector<std::string> &signals =
+                        defaultRecordSignals(),
+                    unsigned int decimation = 1) {
+    if (_thread.joinable())
+      throw std::runtime_error("collect_data() cannot be called while the "
+                               "background loop is running.");
+    if (_has_state)
+      checkRecordIO(_client.robotState(), recordSignals(signals));
+    _recorder.start(file_name, format, signals, decimation);
   }
 
-  void collect_data(std::string file_name) {
+  // Stream the given signals of every decimation-th step to host:port in
+  // batches of batch_size samples, see TelemetryWriter
+  void export_telemetry(const std::string &host, int port,
+                        TelemetryProtocol protocol = TelemetryProtocol::UDP,
+                        const std::vector<std::string> &signals =
+                            defaultRecordSignals(),
+                        unsigned int decimation = 1,
+                        std::size_t batch_size = 20) {
+    if (_thread.joinable())
+      throw std::runtime_error("export_telemetry() cannot be called while the "
+                               "background loop is running.");
+    if (_has_state)
+      checkRecordIO(_client.robotState(), recordSignals(signals));
+    _telemetry.start(
+        [&](const std::vector<RecordColumn> &columns) {
+          return std::make_unique<TelemetryWriter>(host, port, protocol,
+                                                   columns, batch_size);
+        },
+        signals, decimation);
+  }
 
-    _collect_data = true;
-    _time = 0.0;
+  void stop_telemetry() {
+    if (_thread.joinable())
+      throw std::runtime_error("stop_telemetry() cannot be called while the "
+                               "background loop is running.");
+    _telemetry.stop();
+  }
 
-    // Ensure file name ends with .csv extension
-    std::string extension = ".csv";
+  // The writer while exporting, nullptr otherwise
+  const TelemetryWriter *telemetry_writer() const {
+    return dynamic_cast<const TelemetryWriter *>(_telemetry.writer());
+  }
 
-    if (file_name.length() < extension.length() ||
-        file_name.compare(file_name.length() - extension.length(),
-                          extension.length(), extension) != 0) {
-      // File name doesn't end with ".csv", so append the extension.
-      file_name += extension;
+  unsigned long long telemetry_dropped_samples() const {
+    return _telemetry.dropped_samples();
+  }
+
+  bool connect(const int port, char *const remoteHost = NULL) {
+    _port = port;
+    _has_state = false;
+    _remote_host = remoteHost ? remoteHost : "";
+    return _app->connect(port, remoteHost);
+  }
+
+  // Wait at most timeout_ms (< 0 waits indefinitely) for the next session
+  // after the previous one returned to IDLE, returns false on timeout. Unlike
+  // disconnect() and connect(), the socket, recording, telemetry and shared
+  // state stay open, and the client with its controller and estimator is
+  // kept, so step() resumes with the first packet of the new session. The
+  // estimator keeps its state unless reset_estimator is set.
+  bool reconnect(int timeout_ms = -1, bool reset_estimator = false) {
+    if (_thread.joinable())
+      throw std::runtime_error("reconnect() cannot be called while the "
+                               "background loop is running.");
+    if (_port < 0)
+      throw std::runtime_error("reconnect() requires a previous connect()!");
+    _client.set_reset_estimator(reset_estimator);
+
+    // Only reopened if the connection was closed
+    if (!_connection->isOpen() &&
+        !_app->connect(_port,
+                       _remote_host.empty() ? nullptr : _remote_host.c_str()))
+      throw std::runtime_error("Failed to reopen the connection on port " +
+                               std::to_string(_port) + ".");
+    _statistics.restart();
+
+    pybind11::gil_scoped_release release;
+    return _wait(timeout_ms);
+  }
+
+  void disconnect() {
+    if (_thread.joinable())
+      stop_background();
+    _app->disconnect();
+    _publisher.reset();
+    _telemetry.stop();
+    if (_recorder.is_recording()) {
+      _recorder.stop();
+      std::cout << "Saved:" << _recorder.file_name() << "\n";
+      if (_recorder.dropped_samples() > 0)
+        std::cout << "Dropped " << _recorder.dropped_samples()
+                  << " samples, the writer could not keep up.\n";
     }
+  }
 
-    _file_name = file_name;
+  // Wait for the next packet and run one cycle. With timeout_ms >= 0 a
+  // StepTimeout is raised if no packet arrives in time.
+  bool step(int timeout_ms = -1) {
+    if (_thread.joinable())
+      throw std::runtime_error(
+          "step() cannot be called while the background loop is running.");
+
+    // Release the GIL while waiting for the controller, Python callbacks
+    // re-acquire it
+    pybind11::gil_scoped_release release;
+    if (timeout_ms >= 0 && !_wait(timeout_ms))
+      throw StepTimeout("No packet arrived within " +
+                        std::to_string(timeout_ms) + " ms.");
+    return _step();
+  }
 
-    // Open data file
-    _data_file.open(_file_name);
+  // Wait at most timeout_ms (< 0 waits indefinitely) until step() would not
+  // block, returns false on timeout
+  bool wait(int timeout_ms) {
+    if (_thread.joinable())
+      throw std::runtime_error(
+          "wait() cannot be called while the background loop is running.");
+    pybind11::gil_scoped_release release;
+    return _wait(timeout_ms);
+  }
 
-    // Write header
-    _data_file << "index"
-               << ",";
-    _data_file << "time"
-               << ",";
-    _data_file << "record_time_nsec"
-               << ",";
-    _data_file << "tsec"
-               << ",";
-    _data_file << "tnsec"
-               << ",";
+  // Socket to wait on before step(), e.g. with selectors. A new socket is
+  // opened by every connect().
+  int fileno() const {
+    PollableConnection *connection = pollable_connection();
+    if (!connection)
+      throw std::runtime_error(
+          "fileno() requires a SocketConnection or RecordingConnection.");
+    if (connection->fileno() < 0)
+      throw std::runtime_error("The ClientApplication is not connected.");
+    return connection->fileno();
+  }
 
-    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
-      _data_file << "mp" << i + 1 << ",";
+  // Run the receive, command, send cycle on a dedicated thread until the
+  // session returns to IDLE, stop_background() is called or an error occurs.
+  // With across_sessions the loop waits for the next session instead of
+  // stopping at IDLE, as reconnect() does, and reset_estimator restarts the
+  // estimator with every new session.
+  void start_background(int priority = 0, int cpu = -1,
+                        bool across_sessions = false,
+                        bool reset_estimator = false) {
+    if (_thread.joinable())
+      throw std::runtime_error("The background loop is already running.");
+    _client.set_reset_estimator(reset_estimator);
+
+    _background_error.clear();
+    _across_sessions = across_sessions;
+    _running = true;
+    std::promise<std::string> started;
+    std::future<std::string> configured = started.get_future();
+    _thread = std::thread(&PyClientApplication::_background_loop, this,
+                          priority, cpu, std::move(started));
+    _client.set_background(true); // Python cannot run before this returns
+
+    // Wait until the thread has set its priority and affinity
+    const std::string error = configured.get();
+    if (!error.empty()) {
+      _thread.join();
+      _client.set_background(false);
+      throw std::runtime_error(error);
+    }
+  }
 
-    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
-      _data_file << "ip" << i + 1 << ",";
+  // Stops the loop after the current cycle, or within BACKGROUND_POLL_MS
+  // while no packets arrive on a PollableConnection. Raises if the loop stopped
+  // because of an error, e.g. an exception in a Python callback.
+  void stop_background() {
+    if (!_thread.joinable())
+      return;
+
+    {
+      // The thread may need the GIL to finish a Python callback
+      pybind11::gil_scoped_release release;
+      _running = false;
+      _thread.join();
+    }
+    _client.set_background(false);
 
-    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
-      _data_file << "mt" << i + 1 << ",";
+    if (!_background_error.empty())
+      throw std::runtime_error("Background loop failed: " + _background_error);
+  }
 
-    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
-      _data_file << "et" << i + 1 << ",";
+  bool is_running() const { return _running; }
 
-    _data_file << "dt"
-               << "\n";
+  // Publish the state of every cycle to a shared-memory ring that other
+  // processes read with SharedStateReader
+  void publish_state(const std::string &name, std::size_t slots) {
+    if (_thread.joinable())
+      throw std::runtime_error("publish_state() cannot be called while the "
+                               "background loop is running.");
+    _publisher.reset();
+    _publisher = std::make_unique<SharedStatePublisher>(name, slots);
   }
 
-  bool connect(const int port, char *const remoteHost = NULL) {
-    return _app->connect(port, remoteHost);
+  void stop_publishing() {
+    if (_thread.joinable())
+      throw std::runtime_error("stop_publishing() cannot be called while the "
+                               "background loop is running.");
+    _publisher.reset();
   }
 
-  void disconnect() {
-    _app->disconnect();
-    if (_collect_data) {
-      _data_file.close();
-      std::cout << "Saved:" << _file_name << "\n";
+  CycleStatistics &cycle_statistics() { return _statistics; }
+
+  // Give the Python waitForCommand/command budget_us per cycle, after which
+  // the fallback is commanded, see CommandDeadline. budget_us <= 0 removes
+  // the deadline.
+  void set_command_deadline(long long budget_us,
+                            DeadlineFallback fallback =
+                                DeadlineFallback::HOLD_LAST) {
+    if (_thread.joinable())
+      throw std::runtime_error("set_command_deadline() cannot be called while "
+                               "the background loop is running.");
+    _client.set_command_deadline(
+        budget_us > 0 ? std::make_unique<CommandDeadline>(budget_us, fallback)
+                      : nullptr);
+  }
+
+  // Cycles commanded by the fallback of the current deadline
+  unsigned long long fallback_commands() const {
+    const CommandDeadline *deadline = _client.command_deadline();
+    return deadline ? deadline->overruns() : 0;
+  }
+
+  // Latest state of the background loop, returns whether it changed since
+  // the previous call. Without a background loop the current state is read.
+  bool latest_state(LBRStateSnapshot &snapshot) {
+    if (!_thread.joinable()) {
+      takeSnapshot(_client.robotState(), snapshot);
+      return true;
     }
+    const bool fresh = _state_mailbox.update();
+    snapshot = _state_mailbox.read();
+    return fresh;
   }
 
-  bool step() {
+  // Host times of the last packet and reply, zero unless the connection is a
+  // SocketConnection, RecordingConnection or ReplayConnection
+  PacketTimestamps packet_timestamps() const {
+    return _timestamped ? _timestamped->timestamps() : PacketTimestamps();
+  }
+
+  // The connection if it has a socket to wait on, nullptr otherwise
+  PollableConnection *pollable_connection() const {
+    return dynamic_cast<PollableConnection *>(_connection.get());
+  }
+
+private:
+  friend class MultiClientApplication;
+
+  DataRecorder _recorder;
+  DataRecorder _telemetry;
+  PyLBRClient &_client;
+  std::shared_ptr<KUKA::FRI::IConnection> _connection;
+  const TimestampedConnection *_timestamped;
+  std::unique_ptr<KUKA::FRI::ClientApplication> _app;
+  int _port; // of the last connect(), -1 before
+  std::string _remote_host;
+  bool _has_state; // a packet arrived since connect(), e.g. to check IO names
+  std::thread _thread;
+  std::atomic<bool> _running;
+  bool _across_sessions; // the background loop continues after IDLE
+  std::string _background_error;
+  Mailbox<LBRStateSnapshot> _state_mailbox;
+  CycleStatistics _statistics;
+  std::unique_ptr<SharedStatePublisher> _publisher;
+
+  bool _step() {
 
     // Step FRI
+    const long long step_begin = steadyTimeInNanoseconds();
+    _client.callback_time().valid = false;
     if (!_app->step())
       return false;
+    _has_state = true;
+    const PacketTimestamps packet = packet_timestamps();
+    _statistics.record(step_begin, _client.callback_time(),
+                       steadyTimeInNanoseconds(),
+                       _client.robotState().getSampleTime(), packet);
 
     // Optionally record data
     KUKA::FRI::ESessionState currentState =
         _client.robotState().getSessionState();
-    if (_collect_data &&
+    if (_recorder.is_recording() &&
         (currentState == KUKA::FRI::ESessionState::COMMANDING_WAIT ||
          currentState == KUKA::FRI::ESessionState::COMMANDING_ACTIVE)) {
-      _record_data();
+      _recorder.record(_client.robotState(), packet);
     }
 
+    // Optionally stream to a remote consumer, in every session state
+    if (_telemetry.is_recording())
+      _telemetry.record(_client.robotState(), packet);
+
+    // Optionally publish to other processes
+    if (_publisher)
+      _publisher->publish(_client.robotState());
+
     return true;
   }
 
+  bool _wait(int timeout_ms) const {
+    if (PollableConnection *connection = pollable_connection())
+      return connection->wait(timeout_ms);
+
+    // A replayed packet is always ready, the UdpConnection cannot be polled
+    if (timeout_ms < 0 ||
+        dynamic_cast<ReplayConnection *>(_connection.get()) != nullptr)
+      return true;
+    throw std::runtime_error(
+        "A timeout requires a SocketConnection or RecordingConnection.");
+  }
+
+  void _background_loop(int priority, int cpu,
+                        std::promise<std::string> started) {
+    const std::string error = configureRealtimeThread(priority, cpu);
+    started.set_value(error);
+    if (!error.empty()) {
+      _running = false;
+      return;
+    }
+
+    // Without a socket to wait on, stopping has to wait for the next packet
+    PollableConnection *connection = pollable_connection();
+
+    LBRStateSnapshot snapshot;
+    try {
+      while (_running) {
+        if (connection && !connection->wait(BACKGROUND_POLL_MS))
+          continue;
+        if (!_step()) {
+          _background_error = "step() failed, the connection was lost.";
+          break;
+        }
+
+        // Hand the state over to Python
+        takeSnapshot(_client.robotState(), snapshot);
+        _state_mailbox.write(snapshot);
+
+        if (snapshot.session_state == KUKA::FRI::ESessionState::IDLE &&
+            !_across_sessions)
+          break;
+      }
+    } catch (pybind11::error_already_set &e) {
+      pybind11::gil_scoped_acquire acquire;
+      _background_error = e.what();
+    } catch (const std::exception &e) {
+      _background_error = e.what();
+    } catch (...) {
+      // E.g. a KUKA::FRI::FRIException, which must not leave the thread
+      _background_error = "Caught an unknown exception.";
+    }
+    _running = false;
+  }
+};
+
+// Drives several ClientApplications from one thread. Every application
+// needs a PollableConnection; step() waits on all sockets together and steps
+// each robot whose packet has arrived, in the order the applications were
+// given, so a multi-arm cell runs deterministically without a thread per
+// robot.
+class MultiClientApplication {
+
+public:
+  MultiClientApplication(std::vector<PyClientApplication *> apps,
+                         bool release_gil = true)
+      : _apps(std::move(apps)), _release_gil(release_gil),
+        _registered(_apps.size(), {-1, 0}) {
+    if (_apps.empty())
+      throw std::runtime_error("At least one ClientApplication is required.");
+    for (std::size_t i = 0; i < _apps.size(); ++i)
+      if (!_apps[i]->pollable_connection())
+        throw std::runtime_error("ClientApplication " + std::to_string(i) +
+                                 " must use a SocketConnection or "
+                                 "RecordingConnection.");
+  }
+
+  std::size_t size() const { return _apps.size(); }
+
+  // Indices of the robots stepped by the last call to step()
+  const std::vector<std::size_t> &stepped() const { return _stepped; }
+
+  // Wait at most timeout_ms (< 0 waits indefinitely) for packets and step
+  // every robot that received one. Returns false if the step of any robot
+  // failed, e.g. because its connection was lost.
+  bool step(int timeout_ms = -1) {
+    for (PyClientApplication *app : _apps)
+      if (app->_thread.joinable())
+        throw std::runtime_error("step() cannot be called while the "
+                                 "background loop of an application is "
+                                 "running.");
+    _register();
+
+    // Python callbacks re-acquire the GIL while it is released
+    std::unique_ptr<pybind11::gil_scoped_release> release;
+    if (_release_gil)
+      release = std::make_unique<pybind11::gil_scoped_release>();
+
+    _poller.wait(timeout_ms, _ready);
+    std::sort(_ready.begin(), _ready.end());
+
+    bool success = true;
+    _stepped.clear();
+    for (std::size_t i : _ready) {
+      if (_apps[i]->_step())
+        _stepped.push_back(i);
+      else
+        success = false;
+    }
+    return success;
+  }
+
 private:
-  unsigned long long _record_index;
-  long double _time;
-  bool _collect_data;
-  std::string _file_name;
-  std::ofstream _data_file;
-  PyLBRClient &_client;
-  KUKA::FRI::UdpConnection _connection;
-  std::unique_ptr<KUKA::FRI::ClientApplication> _app;
+  std::vector<PyClientApplication *> _apps;
+  bool _release_gil;
+  EventPoller _poller;
+  // Descriptor and generation of every registered socket, reconnecting
+  // replaces the socket
+  std::vector<std::pair<int, unsigned long long>> _registered;
+  std::vector<std::pair<int, unsigned long long>> _sockets;
+  std::vector<std::size_t> _ready;
+  std::vector<std::size_t> _stepped;
+
+  void _register() {
+    _sockets.clear();
+    for (PyClientApplication *app : _apps) {
+      const PollableConnection *connection = app->pollable_connection();
+      _sockets.emplace_back(connection->fileno(), connection->generation());
+    }
 
-  void _record_data() {
+    // The number of a closed descriptor may already belong to the socket of
+    // another application, so a stale registration is only removed through
+    // its number while no socket uses it, and all removals happen before the
+    // new sockets are added
+    auto in_use = [&](int fd) {
+      for (const std::pair<int, unsigned long long> &socket : _sockets)
+        if (socket.first == fd)
+          return true;
+      return false;
+    };
+    for (std::size_t i = 0; i < _apps.size(); ++i) {
+      if (_sockets[i] == _registered[i] || _registered[i].first < 0)
+        continue;
+      if (in_use(_registered[i].first))
+        _poller.release();
+      else
+        _poller.remove(_registered[i].first);
+    }
 
-    // Get state data
-    double mposition[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-    memcpy(mposition, _client.robotState().getMeasuredJointPosition(),
-           KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
+    bool connected = false;
+    for (std::size_t i = 0; i < _apps.size(); ++i) {
+      if (_sockets[i] != _registered[i]) {
+        if (_sockets[i].first >= 0)
+          _poller.add(_sockets[i].first, i);
+        _registered[i] = _sockets[i];
+      }
+      connected = connected || _sockets[i].first >= 0;
+    }
+    if (!connected)
+      throw std::runtime_error("None of the ClientApplications is connected.");
+  }
+};
 
-    double ipoposition[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-    memcpy(ipoposition, _client.robotState().getIpoJointPosition(),
-           KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
+// Python bindings
+namespace py = pybind11;
 
-    double mtorque[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-    memcpy(mtorque, _client.robotState().getMeasuredTorque(),
-           KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
+// Read-only float64 view on an array owned by the SDK state message. The view
+// keeps `base` alive, but the data is only valid until the next call to
+// step().
+template <py::ssize_t Size>
+py::array_t<double> stateView(const double *data, py::handle base) {
+  py::array_t<double> view({Size}, {(py::ssize_t)sizeof(double)}, data, base);
+  py::detail::array_proxy(view.ptr())->flags &=
+      ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+  return view;
+}
 
-    double ext_torque[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-    memcpy(ext_torque, _client.robotState().getExternalTorque(),
-           KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
+// Copy state data into a caller-provided float64 array, avoiding any
+// allocation or conversion. Strided arrays are accepted.
+template <py::ssize_t Size>
+py::array stateCopy(const double *data, py::array out) {
+  if (!py::isinstance<py::array_t<double>>(out) || out.ndim() != 1 ||
+      out.shape(0) != Size) {
+    throw std::runtime_error(
+        "Output array must have dtype float64 and shape (" +
+        std::to_string(Size) + ",)!");
+  }
+  char *ptr = static_cast<char *>(out.mutable_data());
+  const py::ssize_t stride = out.strides(0);
+  if (stride == sizeof(double)) {
+    std::memcpy(ptr, data, Size * sizeof(double));
+    return out;
+  }
+  for (py::ssize_t i = 0; i < Size; ++i)
+    *reinterpret_cast<double *>(ptr + i * stride) = data[i];
+  return out;
+}
 
-    // Record data
-    _data_file << _record_index << ",";
-    _data_file << _time << ",";
-    _data_file << getCurrentTimeInNanoseconds() << ",";
-    _data_file << _client.robotState().getTimestampSec() << ",";
-    _data_file << _client.robotState().getTimestampNanoSec() << ",";
+// Read a 1-D float64 or float32 array of `size` values into `data`,
+// converting element-wise so that neither the dtype nor the strides cause a
+// temporary array. Other inputs, e.g. lists, are converted once.
+template <typename T>
+void readStrided(const py::array &array, py::ssize_t size, double *data) {
+  const char *ptr = static_cast<const char *>(array.data());
+  const py::ssize_t stride = array.strides(0);
+  for (py::ssize_t i = 0; i < size; ++i)
+    data[i] = *reinterpret_cast<const T *>(ptr + i * stride);
+}
 
-    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
-      _data_file << mposition[i] << ",";
+void readCommandValues(py::handle values, py::ssize_t size, double *data) {
+  if (py::isinstance<py::array>(values)) {
+    py::array array = py::reinterpret_borrow<py::array>(values);
+    if (array.ndim() != 1 || array.shape(0) != size) {
+      throw std::runtime_error("Input array must have shape (" +
+                               std::to_string(size) + ",)!");
+    }
+    if (py::isinstance<py::array_t<double>>(array)) {
+      readStrided<double>(array, size, data);
+      return;
+    }
+    if (py::isinstance<py::array_t<float>>(array)) {
+      readStrided<float>(array, size, data);
+      return;
+    }
+  }
 
-    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
-      _data_file << ipoposition[i] << ",";
+  auto converted = py::array_t<double, py::array::forcecast>::ensure(values);
+  if (!converted || converted.ndim() != 1 || converted.shape(0) != size) {
+    throw std::runtime_error("Input array must have shape (" +
+                             std::to_string(size) + ",)!");
+  }
+  readStrided<double>(converted, size, data);
+}
 
-    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
-      _data_file << mtorque[i] << ",";
+// Convert a NumPy array of shape (NUMBER_OF_JOINTS,) to a JointArray
+JointArray toJointArray(py::array_t<double> values) {
+  if (values.ndim() != 1 ||
+      values.shape(0) != KUKA::FRI::LBRState::NUMBER_OF_JOINTS) {
+    throw std::runtime_error(
+        "Input array must have shape (" +
+        std::to_string(KUKA::FRI::LBRState::NUMBER_OF_JOINTS) + ",)!");
+  }
+  JointArray array;
+  for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
+    array[i] = values.at(i);
+  return array;
+}
 
-    for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; ++i)
-      _data_file << ext_torque[i] << ",";
+py::array_t<double> fromJointArray(const JointArray &array) {
+  return py::array_t<double>(array.size(), array.data());
+}
 
-    double sample_time = _client.robotState().getSampleTime();
-    _data_file << sample_time << "\n";
+// Convert a number, applied to every channel, or an array of shape
+// (channels,) to a zero padded JointArray
+JointArray toChannelArray(py::object values, unsigned int channels) {
+  JointArray array = {};
+  if (py::isinstance<py::float_>(values) || py::isinstance<py::int_>(values)) {
+    std::fill(array.begin(), array.begin() + channels, values.cast<double>());
+    return array;
+  }
+  readCommandValues(values, channels, array.data());
+  return array;
+}
+
+py::array_t<double> fromChannelArray(const JointArray &array,
+                                     unsigned int channels) {
+  return py::array_t<double>(channels, array.data());
+}
 
-    // Increment _record_index and _time
-    _record_index++;
-    _time += sample_time;
+unsigned int overlayChannels(OverlayTarget target) {
+  return target == OverlayTarget::WRENCH
+             ? 6
+             : KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+}
+
+using SampleArray =
+    py::array_t<double, py::array::c_style | py::array::forcecast>;
+
+// Filter the 1-D sample x into out, which must be a contiguous float64 array
+// of the same size (it may be x itself)
+py::array filterSample(SignalFilter &filter, SampleArray x, py::array out) {
+  if (x.ndim() != 1)
+    throw std::runtime_error("Input array must be one-dimensional!");
+  if (!py::isinstance<py::array_t<double>>(out) || out.ndim() != 1 ||
+      out.shape(0) != x.shape(0) || !(out.flags() & py::array::c_style)) {
+    throw std::runtime_error(
+        "Output array must be a contiguous float64 array of shape (" +
+        std::to_string(x.shape(0)) + ",)!");
   }
+  filter.filter(x.data(), static_cast<double *>(out.mutable_data()),
+                static_cast<std::size_t>(x.shape(0)));
+  return out;
+}
+
+// `out` if it is a contiguous float64 array of the given shape, or a new array
+// if it is None
+py::array batchOutput(py::object out, const std::vector<py::ssize_t> &shape) {
+  if (out.is_none())
+    return py::array_t<double>(shape);
+  py::array result = out.cast<py::array>();
+  if (!py::isinstance<py::array_t<double>>(result) ||
+      !(result.flags() & py::array::c_style) ||
+      result.ndim() != static_cast<py::ssize_t>(shape.size()) ||
+      !std::equal(shape.begin(), shape.end(), result.shape())) {
+    throw std::runtime_error(
+        "Output array must be a contiguous float64 array of the result "
+        "shape!");
+  }
+  return result;
+}
+
+// Filter the rows of x, one sample of all channels each, into an array of the
+// same shape, either `out` or a new one
+py::array filterBatch(SignalFilter &filter, SampleArray x, py::object out) {
+  if (x.ndim() != 2)
+    throw std::runtime_error("Input array must have shape (n, channels)!");
+  py::array result = batchOutput(out, {x.shape(0), x.shape(1)});
+  const std::size_t rows = x.shape(0), channels = x.shape(1);
+  const double *in = x.data();
+  double *data = static_cast<double *>(result.mutable_data());
+  {
+    py::gil_scoped_release release;
+    for (std::size_t i = 0; i < rows; ++i)
+      filter.filter(in + i * channels, data + i * channels, channels);
+  }
+  return result;
+}
+
+// Evaluate kernel(q, result) for q of shape (N,) or (n, N) into an array of
+// shape ([n,] rows, cols), either `out` or a new one
+template <typename Kernel>
+py::array kinematicsBatch(SampleArray q, py::object out, py::ssize_t rows,
+                          py::ssize_t cols, Kernel kernel) {
+  const py::ssize_t joints = KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+  if ((q.ndim() != 1 && q.ndim() != 2) || q.shape(q.ndim() - 1) != joints) {
+    throw std::runtime_error("Input array must have shape (" +
+                             std::to_string(joints) + ",) or (n, " +
+                             std::to_string(joints) + ")!");
+  }
+  const py::ssize_t count = q.ndim() == 2 ? q.shape(0) : 1;
+  const std::vector<py::ssize_t> shape =
+      q.ndim() == 2 ? std::vector<py::ssize_t>{count, rows, cols}
+                    : std::vector<py::ssize_t>{rows, cols};
+
+  py::array result = batchOutput(out, shape);
+  const double *in = q.data();
+  double *data = static_cast<double *>(result.mutable_data());
+  {
+    py::gil_scoped_release release;
+    for (py::ssize_t i = 0; i < count; ++i)
+      kernel(in + i * joints, data + i * rows * cols);
+  }
+  return result;
+}
+
+// Evaluate kernel(pose, result) for poses of shape ([n,] *in) into an array
+// of shape ([n,] *out), either `out` or a new one
+template <typename Kernel>
+py::array conversionBatch(SampleArray poses, py::object out,
+                          const std::vector<py::ssize_t> &in,
+                          const std::vector<py::ssize_t> &shape,
+                          Kernel kernel) {
+  auto shapeName = [](const std::vector<py::ssize_t> &dims) {
+    std::string name;
+    for (py::ssize_t dim : dims)
+      name += ", " + std::to_string(dim);
+    return name;
+  };
+  const py::ssize_t item = static_cast<py::ssize_t>(in.size());
+  const bool batch = poses.ndim() == item + 1;
+  if ((poses.ndim() != item && !batch) ||
+      !std::equal(in.begin(), in.end(), poses.shape() + (batch ? 1 : 0))) {
+    throw std::runtime_error(
+        "Input array must have shape (" + shapeName(in).substr(2) +
+        (item == 1 ? ",)" : ")") + " or (n" + shapeName(in) + ")!");
+  }
+  const py::ssize_t count = batch ? poses.shape(0) : 1;
+  std::vector<py::ssize_t> result_shape = shape;
+  if (batch)
+    result_shape.insert(result_shape.begin(), count);
+
+  py::array result = batchOutput(out, result_shape);
+  py::ssize_t in_size = 1, out_size = 1;
+  for (py::ssize_t dim : in)
+    in_size *= dim;
+  for (py::ssize_t dim : shape)
+    out_size *= dim;
+  const double *data = poses.data();
+  double *converted = static_cast<double *>(result.mutable_data());
+  for (py::ssize_t i = 0; i < count; ++i)
+    kernel(data + i * in_size, converted + i * out_size);
+  return result;
+}
+
+// Write a [x, y, z, qw, qx, qy, qz] pose of the state as a 4x4 transform into
+// `out`, or into a new array
+py::array cartesianPoseMatrix(const double *pose, py::object out) {
+  if (out.is_none())
+    out = py::array_t<double>({4, 4});
+  py::array result = out.cast<py::array>();
+  if (!py::isinstance<py::array_t<double>>(result) ||
+      !(result.flags() & py::array::c_style) || result.ndim() != 2 ||
+      result.shape(0) != 4 || result.shape(1) != 4) {
+    throw std::runtime_error(
+        "Output array must be a contiguous float64 array of shape (4, 4)!");
+  }
+  quaternionPoseToMatrix(pose, static_cast<double *>(result.mutable_data()));
+  return result;
+}
+
+// Bind getNAME() (a new array), getNAME(out) and the read-only getNAMEView()
+// of a StateSignal, and getNAMEAsMatrix(out=None) of poses
+template <typename Signal>
+void bindStateSignal(py::class_<KUKA::FRI::LBRState> &cls) {
+  using Copy = std::conditional_t<Signal::FLOAT32, float, double>;
+  const std::string name = std::string("get") + Signal::NAME;
+
+  cls.def(
+         name.c_str(),
+         [](const KUKA::FRI::LBRState &self) {
+           py::array_t<Copy> result(Signal::SIZE);
+           Signal::copy(self, result.mutable_data());
+           return result;
+         },
+         Signal::DOC)
+      .def(
+          name.c_str(),
+          [](const KUKA::FRI::LBRState &self, py::array out) {
+            return stateCopy<Signal::SIZE>(Signal::data(self), out);
+          },
+          py::arg("out"))
+      .def((name + "View").c_str(), [](py::object self) {
+        const KUKA::FRI::LBRState &state =
+            self.cast<const KUKA::FRI::LBRState &>();
+        return stateView<Signal::SIZE>(Signal::data(state), self);
+      });
+
+  if constexpr (Signal::POSE)
+    cls.def(
+        (name + "AsMatrix").c_str(),
+        [](const KUKA::FRI::LBRState &self, py::object out) {
+          return cartesianPoseMatrix(Signal::data(self), out);
+        },
+        py::arg("out") = py::none(),
+        "The pose as a 4x4 transform, written into out if given.");
+}
+
+template <typename Signal>
+void writeCommand(KUKA::FRI::LBRCommand &command, py::handle values) {
+  double data[Signal::SIZE];
+  readCommandValues(values, Signal::SIZE, data);
+  CommandDeadline::Write write;
+  Signal::write(command, data);
+  if constexpr (std::is_same_v<Signal, JointPositionCommand>)
+    write.position(data);
+}
+
+// Bind setNAME(values) of a CommandSignal
+template <typename Signal>
+void bindCommandSignal(py::class_<KUKA::FRI::LBRCommand> &cls) {
+  cls.def((std::string("set") + Signal::NAME).c_str(),
+          &writeCommand<Signal>, py::arg("values"));
+}
+
+// Structured dtype of a SnapshotLayout: the LBRStateSnapshot fields followed
+// by one field per IO, named after the IO.
+py::dtype snapshotDtype(const SnapshotLayout &layout) {
+  py::dtype base = py::dtype::of<LBRStateSnapshot>();
+  py::dict fields = base.attr("fields");
+  py::list names, formats, offsets;
+  for (py::handle name : base.attr("names")) {
+    py::tuple field = fields[name];
+    names.append(name);
+    formats.append(field[0]);
+    offsets.append(field[1]);
+  }
+
+  auto append = [&](const std::vector<std::string> &io, const char *format,
+                    std::size_t offset, std::size_t size) {
+    for (std::size_t i = 0; i < io.size(); ++i) {
+      names.append(io[i]);
+      formats.append(format);
+      offsets.append(offset + i * size);
+    }
+  };
+  append(layout.analog_io(), "<f8", layout.analog_offset(), sizeof(double));
+  append(layout.digital_io(), "<u8", layout.digital_offset(),
+         sizeof(std::uint64_t));
+  append(layout.boolean_io(), "?", layout.boolean_offset(), sizeof(bool));
+
+  return py::dtype(names, formats, offsets, layout.itemsize());
+}
+
+// SnapshotLayout together with its NumPy dtype
+class PySnapshotLayout : public SnapshotLayout {
+
+public:
+  PySnapshotLayout(std::vector<std::string> boolean_io,
+                   std::vector<std::string> digital_io,
+                   std::vector<std::string> analog_io)
+      : SnapshotLayout(std::move(boolean_io), std::move(digital_io),
+                       std::move(analog_io)),
+        _dtype(snapshotDtype(*this)) {}
+
+  const py::dtype &dtype() const { return _dtype; }
+
+private:
+  py::dtype _dtype;
 };
 
-// Python bindings
-namespace py = pybind11;
+// Check that `out` can hold a snapshot record of type `dtype` and return a
+// pointer to its first record.
+char *snapshotRecord(py::array &out, const py::dtype &dtype) {
+  py::dtype out_dtype = out.dtype();
+  if ((out_dtype.ptr() != dtype.ptr() && !out_dtype.equal(dtype)) ||
+      out.size() < 1) {
+    throw std::runtime_error(
+        "Output array must have the snapshot dtype and at least one element!");
+  }
+  return static_cast<char *>(out.mutable_data());
+}
 
 PYBIND11_MODULE(_pyfri, m) {
   m.doc() = "Python bindings for the KUKA FRI Client SDK. THIS IS NOT A KUKA "
@@ -208,6 +1076,10 @@ PYBIND11_MODULE(_pyfri, m) {
   m.attr("FRI_CLIENT_VERSION") = std::to_string(FRI_CLIENT_VERSION_MAJOR) +
                                  "." + std::to_string(FRI_CLIENT_VERSION_MINOR);
 
+  py::register_exception<StepTimeout>(m, "StepTimeout", PyExc_TimeoutError);
+  py::register_exception<CommandDeadlineExceeded>(
+      m, "CommandDeadlineExceeded", PyExc_TimeoutError);
+
   py::enum_<KUKA::FRI::ESessionState>(m, "ESessionState")
       .value("IDLE", KUKA::FRI::ESessionState::IDLE)
       .value("MONITORING_WAIT", KUKA::FRI::ESessionState::MONITORING_WAIT)
@@ -280,8 +1152,37 @@ PYBIND11_MODULE(_pyfri, m) {
       .export_values();
 #endif
 
-  py::class_<KUKA::FRI::LBRState>(m, "LBRState")
-      .def(py::init<>())
+#if FRI_CLIENT_VERSION_MAJOR == 1
+  PYBIND11_NUMPY_DTYPE(LBRStateSnapshot, sample_time, tracking_performance,
+                       measured_joint_position, measured_torque,
+                       commanded_torque, external_torque, ipo_joint_position,
+                       commanded_joint_position, timestamp_sec,
+                       timestamp_nanosec, session_state, connection_quality,
+                       safety_state, operation_mode, drive_state,
+                       client_command_mode, overlay_type, control_mode);
+#elif FRI_CLIENT_VERSION_MAJOR == 2
+  PYBIND11_NUMPY_DTYPE(LBRStateSnapshot, sample_time, tracking_performance,
+                       measured_joint_position, measured_torque,
+                       commanded_torque, external_torque, ipo_joint_position,
+                       measured_cartesian_pose, measured_redundancy_value,
+                       timestamp_sec, timestamp_nanosec, session_state,
+                       connection_quality, safety_state, operation_mode,
+                       drive_state, client_command_mode, overlay_type,
+                       control_mode);
+#endif
+
+  m.attr("STATE_SNAPSHOT_DTYPE") = py::dtype::of<LBRStateSnapshot>();
+
+  py::class_<PySnapshotLayout>(m, "SnapshotLayout")
+      .def(py::init<std::vector<std::string>, std::vector<std::string>,
+                    std::vector<std::string>>(),
+           py::arg("boolean_io") = std::vector<std::string>(),
+           py::arg("digital_io") = std::vector<std::string>(),
+           py::arg("analog_io") = std::vector<std::string>())
+      .def_property_readonly("dtype", &PySnapshotLayout::dtype);
+
+  py::class_<KUKA::FRI::LBRState> state(m, "LBRState");
+  state.def(py::init<>())
       .def_property_readonly_static("NUMBER_OF_JOINTS",
                                     [](py::object) {
                                       int num =
@@ -298,241 +1199,1085 @@ PYBIND11_MODULE(_pyfri, m) {
       .def("getOverlayType", &KUKA::FRI::LBRState::getOverlayType)
       .def("getControlMode", &KUKA::FRI::LBRState::getControlMode)
       .def("getTimestampSec", &KUKA::FRI::LBRState::getTimestampSec)
-      .def("getTimestampNanoSec", &KUKA::FRI::LBRState::getTimestampNanoSec)
-      .def("getMeasuredJointPosition",
-           [](const KUKA::FRI::LBRState &self) {
-             // Declare variables
-             double data[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-             float dataf[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-
-             // Retrieve state
-             memcpy(data, self.getMeasuredJointPosition(),
-                    KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
-
-             // Parse: double -> float
-             for (int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; i++)
-               dataf[i] = (float)data[i];
-
-             return py::array_t<float>({KUKA::FRI::LBRState::NUMBER_OF_JOINTS},
-                                       dataf);
-           })
-      .def("getMeasuredTorque",
-           [](const KUKA::FRI::LBRState &self) {
-             // Declare variables
-             double data[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-             float dataf[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-
-             // Retrieve state
-             memcpy(data, self.getMeasuredTorque(),
-                    KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
-
-             // Parse: double -> float
-             for (int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; i++)
-               dataf[i] = (float)data[i];
-
-             return py::array_t<float>({KUKA::FRI::LBRState::NUMBER_OF_JOINTS},
-                                       dataf);
-           })
-      .def("getCommandedTorque",
-           [](const KUKA::FRI::LBRState &self) {
-             // Declare variables
-             double data[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-             float dataf[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-
-             // Retrieve state
-             memcpy(data, self.getCommandedTorque(),
-                    KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
-
-             // Parse: double -> float
-             for (int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; i++)
-               dataf[i] = (float)data[i];
-
-             return py::array_t<float>({KUKA::FRI::LBRState::NUMBER_OF_JOINTS},
-                                       dataf);
-           })
-      .def("getExternalTorque",
-           [](const KUKA::FRI::LBRState &self) {
-             // Declare variables
-             double data[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-             float dataf[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-
-             // Retrieve state
-             memcpy(data, self.getExternalTorque(),
-                    KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
-
-             // Parse: double -> float
-             for (int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; i++)
-               dataf[i] = (float)data[i];
-
-             return py::array_t<float>({KUKA::FRI::LBRState::NUMBER_OF_JOINTS},
-                                       dataf);
-           })
-      .def("getIpoJointPosition",
-           [](const KUKA::FRI::LBRState &self) {
-             // Declare variables
-             double data[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-             float dataf[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-
-             // Retrieve state
-             memcpy(data, self.getIpoJointPosition(),
-                    KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
-
-             // Parse: double -> float
-             for (int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; i++)
-               dataf[i] = (float)data[i];
-
-             return py::array_t<float>({KUKA::FRI::LBRState::NUMBER_OF_JOINTS},
-                                       dataf);
-           })
+      .def("getTimestampNanoSec", &KUKA::FRI::LBRState::getTimestampNanoSec);
+  // getMeasuredJointPosition, getIpoJointPosition etc.
+  forEachSignal<StateSignals>([&state](auto signal) {
+    bindStateSignal<decltype(signal)>(state);
+  });
+  state
+      .def(
+          "snapshot",
+          [](const KUKA::FRI::LBRState &self, py::array out,
+             const PySnapshotLayout *layout) {
+            if (layout) {
+              layout->fill(self, snapshotRecord(out, layout->dtype()));
+            } else {
+              char *record =
+                  snapshotRecord(out, py::dtype::of<LBRStateSnapshot>());
+              takeSnapshot(self, *reinterpret_cast<LBRStateSnapshot *>(record));
+            }
+            return out;
+          },
+          py::arg("out"), py::arg("layout") = nullptr)
       .def("getTrackingPerformance",
            &KUKA::FRI::LBRState::getTrackingPerformance)
       .def("getBooleanIOValue", &KUKA::FRI::LBRState::getBooleanIOValue)
       .def("getDigitalIOValue", &KUKA::FRI::LBRState::getDigitalIOValue)
       .def("getAnalogIOValue", &KUKA::FRI::LBRState::getAnalogIOValue)
-#if FRI_CLIENT_VERSION_MAJOR == 1
-      .def("getCommandedJointPosition",
-           [](const KUKA::FRI::LBRState &self) {
-             // Declare variables
-             double data[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-             float dataf[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-
-             // Retrieve state
-             memcpy(data, self.getCommandedJointPosition(),
-                    KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
-
-             // Parse: double -> float
-             for (int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; i++)
-               dataf[i] = (float)data[i];
-
-             return py::array_t<float>({KUKA::FRI::LBRState::NUMBER_OF_JOINTS},
-                                       dataf);
-           })
-#elif FRI_CLIENT_VERSION_MAJOR == 2
-    .def("getMeasuredCartesianPose",
-	 [](const KUKA::FRI::LBRState &self) {
-
-             // Declare variables
-             double data[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-             float dataf[KUKA::FRI::LBRState::NUMBER_OF_JOINTS];
-
-             // Retrieve state
-             memcpy(data, self.getMeasuredCartesianPose(),
-                    KUKA::FRI::LBRState::NUMBER_OF_JOINTS * sizeof(double));
-
-             // Parse: double -> float
-             for (int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS; i++)
-               dataf[i] = (float)data[i];
-
-             return py::array_t<float>({KUKA::FRI::LBRState::NUMBER_OF_JOINTS},
-                                       dataf);
-           })
-      .def("getMeasuredCartesianPoseAsMatrix",
-           [](const KUKA::FRI::LBRState &self) {
-	     // TODO
-	     throw std::runtime_error("getMeasuredCartesianPoseAsMatrix is not yet exposed (use .getMeasuredCartesianPose instead).");
-           })
-      .def("getIpoCartesianPose",
-           [](const KUKA::FRI::LBRState &self) {
-	     // TODO
-	     // Currently, FRI Cartesian Overlay is not supported by FRI-Client-SDK_Python.
-	     // IPO Cartesian Pose not available when FRI Cartesian Overlay is not active.
-	     throw std::runtime_error("getIpoCartesianPose is not yet exposed.");
-           })
-      .def("getIpoCartesianPoseAsMatrix",
-           [](const KUKA::FRI::LBRState &self) {
-	     // TODO
-	     // Currently, FRI Cartesian Overlay is not supported by FRI-Client-SDK_Python.
-	     // IPO Cartesian Pose not available when FRI Cartesian Overlay is not active.
-	     throw std::runtime_error("getIpoCartesianPoseAsMatrix is not yet exposed.");
-           })
+#if FRI_CLIENT_VERSION_MAJOR == 2
       .def("getMeasuredRedundancyValue",
            &KUKA::FRI::LBRState::getMeasuredRedundancyValue)
       .def("getIpoRedundancyValue",
-	   [](KUKA::FRI::LBRState &self) {
-	     // TODO
-	     // Currently, FRI Cartesian Overlay is not supported by FRI-Client-SDK_Python.
-	     // IPO redundancy value not available when FRI Cartesian Overlay is not active.
-	     throw std::runtime_error("getIpoRedundancyValue is not yet exposed.");
-	   })
+           &KUKA::FRI::LBRState::getIpoRedundancyValue)
       .def("getRedundancyStrategy",
            &KUKA::FRI::LBRState::getRedundancyStrategy)
 #endif
       ; // NOTE: this completes LBRState
 
-  py::class_<KUKA::FRI::LBRCommand>(m, "LBRCommand")
-      .def(py::init<>())
-      .def("setJointPosition",
-           [](KUKA::FRI::LBRCommand &self, py::array_t<double> values) {
-             if (values.ndim() != 1 ||
-                 values.shape(0) != KUKA::FRI::LBRState::NUMBER_OF_JOINTS) {
-               throw std::runtime_error(
-                   "Input array must have shape (" +
-                   std::to_string(KUKA::FRI::LBRState::NUMBER_OF_JOINTS) +
-                   ",)!");
-             }
-             auto buf = values.request();
-             const double *data = static_cast<double *>(buf.ptr);
-             self.setJointPosition(data);
-           })
-      .def("setWrench",
-           [](KUKA::FRI::LBRCommand &self, py::array_t<double> values) {
-             if (values.ndim() != 1 ||
-                 values.shape(0) != 6 // [F_x, F_y, F_z, tau_A, tau_B, tau_C]
-             ) {
-               throw std::runtime_error(
-                   "Input array must have shape (" +
-                   std::to_string(KUKA::FRI::LBRState::NUMBER_OF_JOINTS) +
-                   ",)!");
-             }
-             auto buf = values.request();
-             const double *data = static_cast<double *>(buf.ptr);
-             self.setWrench(data);
-           })
-      .def("setTorque",
-           [](KUKA::FRI::LBRCommand &self, py::array_t<double> values) {
-             if (values.ndim() != 1 ||
-                 values.shape(0) != KUKA::FRI::LBRState::NUMBER_OF_JOINTS) {
-               throw std::runtime_error(
-                   "Input array must have shape (" +
-                   std::to_string(KUKA::FRI::LBRState::NUMBER_OF_JOINTS) +
-                   ",)!");
-             }
-             auto buf = values.request();
-             const double *data = static_cast<double *>(buf.ptr);
-             self.setTorque(data);
-           })
-      .def("setCartesianPose",
-           [](KUKA::FRI::LBRCommand &self, py::array_t<double> values) {
-             // TODO
-             // Currently, FRI Cartesian Overlay is not supported by
-             // FRI-Client-SDK_Python.
-             throw std::runtime_error("setCartesianPose is not yet exposed.");
+  py::class_<KUKA::FRI::LBRCommand> command(m, "LBRCommand");
+  command.def(py::init<>());
+  // setJointPosition, setWrench and setTorque
+  forEachSignal<CommandSignals>([&command](auto signal) {
+    bindCommandSignal<decltype(signal)>(command);
+  });
+  command
+      .def(
+          "setCommand",
+          [](KUKA::FRI::LBRCommand &self, py::handle position,
+             py::handle torque, py::handle wrench) {
+            if (!position.is_none())
+              writeCommand<JointPositionCommand>(self, position);
+            if (!torque.is_none())
+              writeCommand<TorqueCommand>(self, torque);
+            if (!wrench.is_none())
+              writeCommand<WrenchCommand>(self, wrench);
+          },
+          py::arg("position") = py::none(), py::arg("torque") = py::none(),
+          py::arg("wrench") = py::none(),
+          "Set any of the joint position, torque and wrench in one call.")
+#if FRI_CLIENT_VERSION_MAJOR == 2
+      .def(
+          "setCartesianPose",
+          [](KUKA::FRI::LBRCommand &self, py::handle values,
+             py::object redundancy) {
+            double data[QUATERNION_POSE_SIZE]; // [x, y, z, qw, qx, qy, qz]
+            readCommandValues(values, QUATERNION_POSE_SIZE, data);
+            CommandDeadline::Write write;
+            if (redundancy.is_none()) {
+              self.setCartesianPose(data);
+              write.pose(data, nullptr);
+            } else {
+              const double value = redundancy.cast<double>();
+              self.setCartesianPose(data, &value);
+              write.pose(data, &value);
+            }
+          },
+          py::arg("values"), py::arg("redundancy") = py::none())
+      .def(
+          "setCartesianPoseAsMatrix",
+          [](KUKA::FRI::LBRCommand &self, SampleArray values,
+             py::object redundancy) {
+            // The bottom row of a 4x4 transform is ignored
+            if (values.ndim() != 2 ||
+                (values.shape(0) != 3 && values.shape(0) != 4) ||
+                values.shape(1) != 4) {
+              throw std::runtime_error(
+                  "Input array must have shape (4, 4) or (3, 4)!");
+            }
+            double data[3][4];
+            std::memcpy(data, values.data(), sizeof(data));
+            // Held as a quaternion pose, the rows match a 4x4 transform
+            double pose[QUATERNION_POSE_SIZE];
+            matrixToQuaternionPose(&data[0][0], pose);
+            CommandDeadline::Write write;
+            if (redundancy.is_none()) {
+              self.setCartesianPoseAsMatrix(data);
+              write.pose(pose, nullptr);
+            } else {
+              const double value = redundancy.cast<double>();
+              self.setCartesianPoseAsMatrix(data, &value);
+              write.pose(pose, &value);
+            }
+          },
+          py::arg("values"), py::arg("redundancy") = py::none())
+#endif
+      .def("setBooleanIOValue",
+           [](KUKA::FRI::LBRCommand &self, const char *name, bool value) {
+             CommandDeadline::Write write;
+             self.setBooleanIOValue(name, value);
            })
-      .def("setCartesianPoseAsMatrix",
-           [](KUKA::FRI::LBRCommand &self, py::array_t<double> values) {
-             // TODO
-             // Currently, FRI Cartesian Overlay is not supported by
-             // FRI-Client-SDK_Python.
-             throw std::runtime_error(
-                 "setCartesianPoseAsMatrix is not yet exposed.");
+      .def("setDigitalIOValue",
+           [](KUKA::FRI::LBRCommand &self, const char *name,
+              unsigned long long value) {
+             CommandDeadline::Write write;
+             self.setDigitalIOValue(name, value);
            })
-      .def("setBooleanIOValue", &KUKA::FRI::LBRCommand::setBooleanIOValue)
-      .def("setDigitalIOValue", &KUKA::FRI::LBRCommand::setDigitalIOValue)
-      .def("setAnalogIOValue", &KUKA::FRI::LBRCommand::setAnalogIOValue);
+      .def("setAnalogIOValue",
+           [](KUKA::FRI::LBRCommand &self, const char *name, double value) {
+             CommandDeadline::Write write;
+             self.setAnalogIOValue(name, value);
+           });
+
+  py::class_<SignalFilter>(m, "SignalFilter")
+      .def(
+          "filter",
+          [](SignalFilter &self, SampleArray x) {
+            return filterSample(self, x, py::array_t<double>(x.size()));
+          },
+          py::arg("x"))
+      .def("filter", &filterSample, py::arg("x"), py::arg("out"),
+           "Filter x into the preallocated float64 array out (may be x).")
+      .def("filter_batch", &filterBatch, py::arg("x"),
+           py::arg("out") = py::none(),
+           "Filter the rows of x (n, channels) in order, as n calls of "
+           "filter() would, with the GIL released.")
+      .def("reset", &SignalFilter::reset)
+      .def_property_readonly("size", &SignalFilter::size,
+                             "Number of channels, 0 before the first sample.");
+
+  py::class_<ExponentialFilter, SignalFilter>(m, "ExponentialFilter")
+      .def(py::init<double>(), py::arg("smooth") = 0.02)
+      .def_property_readonly("smooth", &ExponentialFilter::smooth);
+
+  py::class_<MovingAverageFilter, SignalFilter>(m, "MovingAverageFilter")
+      .def(py::init<std::size_t>(), py::arg("window_size"))
+      .def_property_readonly("window_size", &MovingAverageFilter::window_size);
+
+  py::class_<ButterworthFilter, SignalFilter>(m, "ButterworthFilter")
+      .def(py::init<double, double, unsigned int>(),
+           py::arg("cutoff_frequency"), py::arg("sample_frequency"),
+           py::arg("order") = 2)
+      .def_property_readonly("cutoff_frequency",
+                             &ButterworthFilter::cutoff_frequency)
+      .def_property_readonly("sample_frequency",
+                             &ButterworthFilter::sample_frequency)
+      .def_property_readonly("order", &ButterworthFilter::order);
+
+  py::class_<MedianFilter, SignalFilter>(m, "MedianFilter")
+      .def(py::init<std::size_t>(), py::arg("window_size"))
+      .def_property_readonly("window_size", &MedianFilter::window_size);
+
+  m.def(
+      "pinv",
+      [](SampleArray jacobian, double rcond, double damping) {
+        const py::ssize_t rows = TASK_DIMENSION;
+        const py::ssize_t joints = KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+        const py::ssize_t ndim = jacobian.ndim();
+        if ((ndim != 2 && ndim != 3) ||
+            jacobian.shape(ndim - 2) != rows ||
+            jacobian.shape(ndim - 1) != joints) {
+          throw std::runtime_error(
+              "Input array must have shape (6, " + std::to_string(joints) +
+              ") or (n, 6, " + std::to_string(joints) + ")!");
+        }
+        const py::ssize_t count = ndim == 3 ? jacobian.shape(0) : 1;
+        py::array_t<double> inverse(
+            ndim == 3 ? std::vector<py::ssize_t>{count, joints, rows}
+                      : std::vector<py::ssize_t>{joints, rows});
+
+        const double *in = jacobian.data();
+        double *out = inverse.mutable_data();
+        {
+          py::gil_scoped_release release;
+          for (py::ssize_t i = 0; i < count; ++i)
+            pseudoInverse(in + i * rows * joints, rcond, damping,
+                          out + i * joints * rows);
+        }
+        return inverse;
+      },
+      py::arg("jacobian"), py::arg("rcond") = PSEUDO_INVERSE_MIN_RCOND,
+      py::arg("damping") = 0.0,
+      "Pseudo-inverse of a 6 x NUMBER_OF_JOINTS Jacobian, or of a stack of "
+      "them. Singular values <= rcond * max are dropped, damping > 0 gives "
+      "the damped least-squares inverse. It is computed from J J^T, which "
+      "resolves singular values only down to about sqrt(eps) * max, so "
+      "rcond is at least 1.5e-8 and matches numpy.linalg.pinv only for "
+      "Jacobians whose kept singular values lie well above that.");
+
+  const std::vector<py::ssize_t> quaternion_pose{QUATERNION_POSE_SIZE},
+      abc_pose{ABC_POSE_SIZE}, transform{4, 4};
+  m.def(
+      "quaternion_pose_to_matrix",
+      [quaternion_pose, transform](SampleArray pose, py::object out) {
+        return conversionBatch(pose, out, quaternion_pose, transform,
+                               quaternionPoseToMatrix);
+      },
+      py::arg("pose"), py::arg("out") = py::none(),
+      "4x4 transform(s) of [x, y, z, qw, qx, qy, qz] pose(s).");
+  m.def(
+      "matrix_to_quaternion_pose",
+      [quaternion_pose, transform](SampleArray matrix, py::object out) {
+        return conversionBatch(matrix, out, transform, quaternion_pose,
+                               matrixToQuaternionPose);
+      },
+      py::arg("matrix"), py::arg("out") = py::none(),
+      "[x, y, z, qw, qx, qy, qz] pose(s) with qw >= 0 of 4x4 transform(s).");
+  m.def(
+      "abc_pose_to_matrix",
+      [abc_pose, transform](SampleArray pose, py::object out) {
+        return conversionBatch(pose, out, abc_pose, transform,
+                               abcPoseToMatrix);
+      },
+      py::arg("pose"), py::arg("out") = py::none(),
+      "4x4 transform(s) of KUKA [x, y, z, A, B, C] pose(s), angles in "
+      "radians.");
+  m.def(
+      "matrix_to_abc_pose",
+      [abc_pose, transform](SampleArray matrix, py::object out) {
+        return conversionBatch(matrix, out, transform, abc_pose,
+                               matrixToAbcPose);
+      },
+      py::arg("matrix"), py::arg("out") = py::none(),
+      "KUKA [x, y, z, A, B, C] pose(s) of 4x4 transform(s).");
+
+  py::class_<Kinematics>(m, "Kinematics",
+                         "Forward kinematics and geometric Jacobian of the "
+                         "tip link, compiled from the bundled robot "
+                         "descriptions.")
+      .def(py::init(&makeKinematics), py::arg("robot"))
+      .def_property_readonly("name", &Kinematics::name)
+      .def_property_readonly("base_link", &Kinematics::base_link)
+      .def_property_readonly("tip_link", &Kinematics::tip_link)
+      .def_property_readonly("joint_names",
+                             [](const Kinematics &self) {
+                               std::vector<std::string> names;
+                               for (unsigned int i = 0;
+                                    i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+                                    ++i)
+                                 names.push_back(self.joint_name(i));
+                               return names;
+                             })
+      .def(
+          "forward_kinematics",
+          [](const Kinematics &self, SampleArray q, py::object out) {
+            return kinematicsBatch(
+                q, out, 4, 4,
+                [&self](const double *position, double *transform) {
+                  self.forward_kinematics(position, transform);
+                });
+          },
+          py::arg("q"), py::arg("out") = py::none(),
+          "Tip transform(s) of shape ([n,] 4, 4) for q of shape ([n,] N).")
+      .def(
+          "jacobian",
+          [](const Kinematics &self, SampleArray q, py::object out) {
+            return kinematicsBatch(
+                q, out, TASK_DIMENSION, KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+                [&self](const double *position, double *jacobian) {
+                  self.jacobian(position, jacobian);
+                });
+          },
+          py::arg("q"), py::arg("out") = py::none(),
+          "Geometric Jacobian(s) of shape ([n,] 6, N), linear rows first.");
+
+  py::class_<NativeController, std::shared_ptr<NativeController>>(
+      m, "NativeController");
+
+  py::class_<JointSineOverlay, NativeController,
+             std::shared_ptr<JointSineOverlay>>(m, "JointSineOverlay")
+      .def(py::init([](py::array_t<double> amplitude, double frequency,
+                       double filter_coefficient) {
+             return std::make_shared<JointSineOverlay>(
+                 JointSineOverlay::Parameters{toJointArray(amplitude),
+                                              frequency, filter_coefficient});
+           }),
+           py::arg("amplitude"), py::arg("frequency"),
+           py::arg("filter_coefficient") = 0.99)
+      .def_property(
+          "amplitude",
+          [](const JointSineOverlay &self) {
+            return fromJointArray(self.parameters().amplitude);
+          },
+          [](JointSineOverlay &self, py::array_t<double> amplitude) {
+            JointSineOverlay::Parameters p = self.parameters();
+            p.amplitude = toJointArray(amplitude);
+            self.set_parameters(p);
+          })
+      .def_property(
+          "frequency",
+          [](const JointSineOverlay &self) {
+            return self.parameters().frequency;
+          },
+          [](JointSineOverlay &self, double frequency) {
+            JointSineOverlay::Parameters p = self.parameters();
+            p.frequency = frequency;
+            self.set_parameters(p);
+          })
+      .def_property(
+          "filter_coefficient",
+          [](const JointSineOverlay &self) {
+            return self.parameters().filter_coefficient;
+          },
+          [](JointSineOverlay &self, double filter_coefficient) {
+            JointSineOverlay::Parameters p = self.parameters();
+            p.filter_coefficient = filter_coefficient;
+            self.set_parameters(p);
+          });
+
+  py::class_<JointImpedance, NativeController, std::shared_ptr<JointImpedance>>(
+      m, "JointImpedance")
+      .def(py::init([](py::array_t<double> stiffness,
+                       py::array_t<double> damping,
+                       py::array_t<double> max_torque) {
+             return std::make_shared<JointImpedance>(
+                 JointImpedance::Parameters{
+                     toJointArray(stiffness), toJointArray(damping),
+                     toJointArray(max_torque), JointArray{}, false});
+           }),
+           py::arg("stiffness"), py::arg("damping"), py::arg("max_torque"))
+      .def_property(
+          "stiffness",
+          [](const JointImpedance &self) {
+            return fromJointArray(self.parameters().stiffness);
+          },
+          [](JointImpedance &self, py::array_t<double> stiffness) {
+            JointImpedance::Parameters p = self.parameters();
+            p.stiffness = toJointArray(stiffness);
+            self.set_parameters(p);
+          })
+      .def_property(
+          "damping",
+          [](const JointImpedance &self) {
+            return fromJointArray(self.parameters().damping);
+          },
+          [](JointImpedance &self, py::array_t<double> damping) {
+            JointImpedance::Parameters p = self.parameters();
+            p.damping = toJointArray(damping);
+            self.set_parameters(p);
+          })
+      .def_property(
+          "max_torque",
+          [](const JointImpedance &self) {
+            return fromJointArray(self.parameters().max_torque);
+          },
+          [](JointImpedance &self, py::array_t<double> max_torque) {
+            JointImpedance::Parameters p = self.parameters();
+            p.max_torque = toJointArray(max_torque);
+            self.set_parameters(p);
+          })
+      .def_property(
+          "target",
+          [](const JointImpedance &self) -> py::object {
+            if (!self.parameters().has_target)
+              return py::none();
+            return fromJointArray(self.parameters().target);
+          },
+          [](JointImpedance &self, py::object target) {
+            // None holds the position measured when commanding starts
+            JointImpedance::Parameters p = self.parameters();
+            p.has_target = !target.is_none();
+            if (p.has_target)
+              p.target = toJointArray(target.cast<py::array_t<double>>());
+            self.set_parameters(p);
+          });
+
+  py::class_<CommandMailbox, NativeController, std::shared_ptr<CommandMailbox>>(
+      m, "CommandMailbox",
+      "Applies the latest command written from any Python thread, without "
+      "blocking the FRI cycle.")
+      .def(py::init([](double timeout, py::object max_velocity,
+                       bool interpolate) {
+             CommandMailbox::Parameters parameters{};
+             parameters.timeout = timeout;
+             if (!max_velocity.is_none())
+               parameters.max_velocity = toChannelArray(
+                   max_velocity, KUKA::FRI::LBRState::NUMBER_OF_JOINTS);
+             parameters.interpolate = interpolate;
+             return std::make_shared<CommandMailbox>(parameters);
+           }),
+           py::arg("timeout") = 0.0, py::arg("max_velocity") = py::none(),
+           py::arg("interpolate") = false,
+           "Commands older than timeout (s, 0 never) are dropped: the "
+           "position is held and torque/wrench are zeroed. max_velocity "
+           "(rad/s, a number or one value per joint) limits the commanded "
+           "position's rate, interpolate moves linearly to each written "
+           "position over the interval since the previous write.")
+      .def_property(
+          "timeout",
+          [](const CommandMailbox &self) { return self.parameters().timeout; },
+          [](CommandMailbox &self, double timeout) {
+            CommandMailbox::Parameters p = self.parameters();
+            p.timeout = timeout;
+            self.set_parameters(p);
+          })
+      .def_property(
+          "max_velocity",
+          [](const CommandMailbox &self) {
+            return fromJointArray(self.parameters().max_velocity);
+          },
+          [](CommandMailbox &self, py::object max_velocity) {
+            CommandMailbox::Parameters p = self.parameters();
+            p.max_velocity = max_velocity.is_none()
+                                 ? JointArray{}
+                                 : toChannelArray(
+                                       max_velocity,
+                                       KUKA::FRI::LBRState::NUMBER_OF_JOINTS);
+            self.set_parameters(p);
+          })
+      .def_property(
+          "interpolate",
+          [](const CommandMailbox &self) {
+            return self.parameters().interpolate;
+          },
+          [](CommandMailbox &self, bool interpolate) {
+            CommandMailbox::Parameters p = self.parameters();
+            p.interpolate = interpolate;
+            self.set_parameters(p);
+          })
+      .def_property_readonly("stale_cycles", &CommandMailbox::stale_cycles)
+      .def(
+          "write",
+          [](CommandMailbox &self, py::handle position, py::handle torque,
+             py::handle wrench) {
+            CommandMailbox::Command command{};
+            command.has_position = !position.is_none();
+            if (command.has_position)
+              readCommandValues(position, KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+                                command.position.data());
+            command.has_torque = !torque.is_none();
+            if (command.has_torque)
+              readCommandValues(torque, KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+                                command.torque.data());
+            command.has_wrench = !wrench.is_none();
+            if (command.has_wrench)
+              readCommandValues(wrench, 6, command.wrench.data());
+            self.write(command);
+          },
+          py::arg("position") = py::none(), py::arg("torque") = py::none(),
+          py::arg("wrench") = py::none(),
+          "Replace the command applied in the next cycles. Values that are "
+          "not given are not commanded (position holds the ipo position).");
+
+  // Not exported, the names clash with EClientCommandMode
+  py::enum_<OverlayTarget>(m, "OverlayTarget")
+      .value("JOINT_POSITION", OverlayTarget::JOINT_POSITION)
+      .value("TORQUE", OverlayTarget::TORQUE)
+      .value("WRENCH", OverlayTarget::WRENCH);
+
+  py::class_<SineOverlay, NativeController, std::shared_ptr<SineOverlay>>(
+      m, "SineOverlay",
+      "Sine waves overlaid on the ipo joint position, or commanded as torque "
+      "or wrench in the matching client command mode.")
+      .def(py::init([](OverlayTarget target, py::object amplitude,
+                       py::object frequency) {
+             const unsigned int channels = overlayChannels(target);
+             return std::make_shared<SineOverlay>(
+                 target,
+                 SineOverlay::Parameters{toChannelArray(amplitude, channels),
+                                         toChannelArray(frequency, channels)});
+           }),
+           py::arg("target"), py::arg("amplitude"), py::arg("frequency"),
+           "amplitude and frequency (Hz) are numbers or arrays with one value "
+           "per joint, or per wrench component.")
+      .def_property_readonly("target", &SineOverlay::target)
+      .def_property(
+          "amplitude",
+          [](const SineOverlay &self) {
+            return fromChannelArray(self.parameters().amplitude,
+                                    overlayChannels(self.target()));
+          },
+          [](SineOverlay &self, py::object amplitude) {
+            SineOverlay::Parameters p = self.parameters();
+            p.amplitude =
+                toChannelArray(amplitude, overlayChannels(self.target()));
+            self.set_parameters(p);
+          })
+      .def_property(
+          "frequency",
+          [](const SineOverlay &self) {
+            return fromChannelArray(self.parameters().frequency,
+                                    overlayChannels(self.target()));
+          },
+          [](SineOverlay &self, py::object frequency) {
+            SineOverlay::Parameters p = self.parameters();
+            p.frequency =
+                toChannelArray(frequency, overlayChannels(self.target()));
+            self.set_parameters(p);
+          });
+
+  py::enum_<MotionProfile>(m, "MotionProfile")
+      .value("CUBIC", MotionProfile::CUBIC)
+      .value("QUINTIC", MotionProfile::QUINTIC)
+      .value("MIN_JERK", MotionProfile::MIN_JERK)
+      .value("TRAPEZOIDAL", MotionProfile::TRAPEZOIDAL)
+      .export_values();
+
+  py::class_<JointTrajectory, NativeController,
+             std::shared_ptr<JointTrajectory>>(
+      m, "JointTrajectory",
+      "Joint trajectory through waypoints streamed from Python, starting at "
+      "the ipo position when commanding starts. The last waypoint is held.")
+      .def(py::init([](py::object max_velocity, py::object max_acceleration) {
+             const JointTrajectory::Limits limits{
+                 toChannelArray(max_velocity,
+                                KUKA::FRI::LBRState::NUMBER_OF_JOINTS),
+                 toChannelArray(max_acceleration,
+                                KUKA::FRI::LBRState::NUMBER_OF_JOINTS)};
+             for (unsigned int i = 0; i < KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+                  ++i)
+               if (!(limits.max_velocity[i] > 0.0) ||
+                   !(limits.max_acceleration[i] > 0.0))
+                 throw std::runtime_error("The limits must be positive!");
+             return std::make_shared<JointTrajectory>(limits);
+           }),
+           py::arg("max_velocity"), py::arg("max_acceleration"),
+           "Limits (rad/s, rad/s^2) of the TRAPEZOIDAL profile, numbers or "
+           "arrays with one value per joint.")
+      .def_property_readonly_static(
+          "CAPACITY",
+          [](py::object) { return JointTrajectory::CAPACITY; })
+      .def(
+          "push",
+          [](JointTrajectory &self, py::handle position, double duration,
+             MotionProfile profile, py::object velocity) {
+            Waypoint waypoint{};
+            readCommandValues(position, KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+                              waypoint.position.data());
+            if (!velocity.is_none())
+              readCommandValues(velocity,
+                                KUKA::FRI::LBRState::NUMBER_OF_JOINTS,
+                                waypoint.velocity.data());
+            if (!(duration > 0.0) &&
+                !(profile == MotionProfile::TRAPEZOIDAL && duration == 0.0))
+              throw std::runtime_error("duration must be positive!");
+            waypoint.duration = duration;
+            waypoint.profile = profile;
+            return self.push(waypoint);
+          },
+          py::arg("position"), py::arg("duration"),
+          py::arg("profile") = MotionProfile::MIN_JERK,
+          py::arg("velocity") = py::none(),
+          "Queue a waypoint reached duration seconds after the previous one "
+          "(a TRAPEZOIDAL segment is stretched to the limits, 0 moves as fast "
+          "as they allow). velocity is used by CUBIC and QUINTIC. Returns "
+          "False if the queue is full.")
+      .def_property_readonly("pending", &JointTrajectory::pending,
+                             "Waypoints queued or being approached.");
+
+  py::class_<AdmittanceController, NativeController,
+             std::shared_ptr<AdmittanceController>>
+      admittance(m, "AdmittanceController",
+                 "Hand guiding: the tip follows the external wrench estimated "
+                 "from the external torque through a mass-damper.");
+  admittance
+      .def(py::init([](const std::string &robot, py::object mass,
+                       py::object damping, py::object threshold,
+                       py::object max_velocity, py::object lower,
+                       py::object upper, double smooth, double rcond,
+                       std::size_t offset_samples) {
+             constexpr unsigned int N = KUKA::FRI::LBRState::NUMBER_OF_JOINTS;
+             AdmittanceController::Parameters p{};
+             p.mass = toChannelArray(mass, TASK_DIMENSION);
+             p.damping = toChannelArray(damping, TASK_DIMENSION);
+             p.threshold = toChannelArray(threshold, TASK_DIMENSION);
+             p.max_velocity = toChannelArray(max_velocity, TASK_DIMENSION);
+             // No joint limits by default
+             p.lower.fill(-INFINITY);
+             p.upper.fill(INFINITY);
+             if (!lower.is_none())
+               p.lower = toChannelArray(lower, N);
+             if (!upper.is_none())
+               p.upper = toChannelArray(upper, N);
+             p.smooth = smooth;
+             p.rcond = rcond;
+             return std::make_shared<AdmittanceController>(robot, p,
+                                                            offset_samples);
+           }),
+           py::arg("robot"), py::arg("mass") = 0.0,
+           py::arg("damping") = py::make_tuple(20.0, 20.0, 20.0, 3.0, 3.0, 3.0),
+           py::arg("threshold") = 0.0,
+           py::arg("max_velocity") =
+               py::make_tuple(0.2, 0.2, 0.2, 0.7, 0.7, 0.7),
+           py::arg("lower") = py::none(), py::arg("upper") = py::none(),
+           py::arg("smooth") = 0.02, py::arg("rcond") = 0.05,
+           py::arg("offset_samples") = 50,
+           "robot is 'med7' or 'med14'. mass (kg, kgm^2), damping (Ns/m, "
+           "Nms/rad), threshold (N, Nm) and max_velocity (m/s, rad/s) are "
+           "numbers or arrays of shape (6,), linear first. lower and upper "
+           "are the joint limits (rad). The wrench offset is the mean over "
+           "the first offset_samples cycles of commanding.")
+      .def_property_readonly("robot", &AdmittanceController::robot)
+      .def_property_readonly("offset_samples",
+                             &AdmittanceController::offset_samples)
+      .def_property_readonly("ready", &AdmittanceController::ready,
+                             "Whether the offset was estimated and the robot "
+                             "follows the wrench.")
+      .def_property(
+          "smooth",
+          [](const AdmittanceController &self) {
+            return self.parameters().smooth;
+          },
+          [](AdmittanceController &self, double smooth) {
+            AdmittanceController::Parameters p = self.parameters();
+            p.smooth = smooth;
+            self.set_parameters(p);
+          })
+      .def_property(
+          "rcond",
+          [](const AdmittanceController &self) {
+            return self.parameters().rcond;
+          },
+          [](AdmittanceController &self, double rcond) {
+            AdmittanceController::Parameters p = self.parameters();
+            p.rcond = rcond;
+            self.set_parameters(p);
+          });
+  {
+    using Parameters = AdmittanceController::Parameters;
+    const std::pair<const char *, JointArray Parameters::*> task[] = {
+        {"mass", &Parameters::mass},
+        {"damping", &Parameters::damping},
+        {"threshold", &Parameters::threshold},
+        {"max_velocity", &Parameters::max_velocity}};
+    const std::pair<const char *, JointArray Parameters::*> joints[] = {
+        {"lower", &Parameters::lower}, {"upper", &Parameters::upper}};
+    auto property = [&admittance](const char *name,
+                                  JointArray Parameters::*member,
+                                  unsigned int channels) {
+      admittance.def_property(
+          name,
+          [member, channels](const AdmittanceController &self) {
+            return fromChannelArray(self.parameters().*member, channels);
+          },
+          [member, channels](AdmittanceController &self, py::object values) {
+            Parameters p = self.parameters();
+            p.*member = toChannelArray(values, channels);
+            self.set_parameters(p);
+          });
+    };
+    for (const auto &entry : task)
+      property(entry.first, entry.second, TASK_DIMENSION);
+    for (const auto &entry : joints)
+      property(entry.first, entry.second,
+               KUKA::FRI::LBRState::NUMBER_OF_JOINTS);
+  }
 
   py::class_<KUKA::FRI::LBRClient, PyLBRClient>(m, "LBRClient")
-      .def(py::init<>())
+      .def(py::init_alias<>())
       .def("onStateChange", &KUKA::FRI::LBRClient::onStateChange)
       .def("monitor", &KUKA::FRI::LBRClient::monitor)
       .def("waitForCommand", &KUKA::FRI::LBRClient::waitForCommand)
       .def("command", &KUKA::FRI::LBRClient::command)
       .def("robotState", &KUKA::FRI::LBRClient::robotState)
-      .def("robotCommand", &KUKA::FRI::LBRClient::robotCommand);
+      .def("robotCommand", &KUKA::FRI::LBRClient::robotCommand)
+      // Lambdas, since member pointers of the trampoline cannot be bound to
+      // the LBRClient class
+      .def(
+          "set_controller",
+          [](PyLBRClient &self, std::shared_ptr<NativeController> controller) {
+            self.set_controller(std::move(controller));
+          },
+          py::arg("controller"),
+          "Run a native controller inside step() instead of the Python "
+          "callbacks, None restores the Python callbacks.")
+      .def_property_readonly("controller",
+                             [](const PyLBRClient &self) {
+                               return self.controller();
+                             })
+      .def(
+          "set_state_estimator",
+          [](PyLBRClient &self,
+             std::shared_ptr<JointStateEstimator> estimator) {
+            self.set_state_estimator(std::move(estimator));
+          },
+          py::arg("estimator"),
+          "Update the estimator inside step(), None detaches it.")
+      .def_property_readonly("state_estimator", [](const PyLBRClient &self) {
+        return self.state_estimator();
+      });
+
+  py::enum_<EstimationMethod>(m, "EstimationMethod")
+      .value("FINITE_DIFFERENCE", EstimationMethod::FINITE_DIFFERENCE)
+      .value("SAVITZKY_GOLAY", EstimationMethod::SAVITZKY_GOLAY)
+      .value("KALMAN", EstimationMethod::KALMAN)
+      .export_values();
+
+  m.def(
+      "estimate_joint_states",
+      [](SampleArray q, SampleArray dt, EstimationMethod method,
+         std::size_t window, unsigned int polynomial_order,
+         double process_noise, double measurement_noise, std::size_t threads) {
+        const py::ssize_t joints = JointStateEstimator::N;
+        if (q.ndim() != 2 || q.shape(1) != joints)
+          throw std::runtime_error("Input array must have shape (n, " +
+                                   std::to_string(joints) + ")!");
+        const py::ssize_t rows = q.shape(0);
+        if (dt.ndim() > 1 || (dt.ndim() == 1 && dt.shape(0) != rows))
+          throw std::runtime_error(
+              "dt must be a scalar or an array of shape (n,)!");
+        const JointStateEstimator prototype(method, window, polynomial_order,
+                                            process_noise, measurement_noise);
+        py::array_t<double> position({rows, joints}), velocity({rows, joints}),
+            acceleration({rows, joints});
+
+        const double *positions = q.data();
+        const double *times = dt.data();
+        double *p = position.mutable_data(), *v = velocity.mutable_data(),
+               *a = acceleration.mutable_data();
+        {
+          py::gil_scoped_release release;
+          estimateJointStates(prototype, positions, times,
+                              dt.ndim() == 1 ? 1 : 0, rows, p, v, a, threads);
+        }
+        return py::make_tuple(position, velocity, acceleration);
+      },
+      py::arg("q"), py::arg("dt"),
+      py::arg("method") = EstimationMethod::FINITE_DIFFERENCE,
+      py::arg("window") = 7, py::arg("polynomial_order") = 2,
+      py::arg("process_noise") = 1e4, py::arg("measurement_noise") = 1e-10,
+      py::arg("threads") = 0,
+      "Position, velocity and acceleration (n, NUMBER_OF_JOINTS) that a "
+      "JointStateEstimator attached at the first row estimates from the "
+      "measured joint positions q (n, NUMBER_OF_JOINTS) and the sample "
+      "time(s) dt, computed over threads threads (0 for one per core).");
+
+  py::class_<JointStateEstimator, std::shared_ptr<JointStateEstimator>>(
+      m, "JointStateEstimator",
+      "Joint position, velocity and acceleration estimated inside step(). "
+      "Views returned by the getters are valid until the next step().")
+      .def(py::init([](PyLBRClient &client, EstimationMethod method,
+                       std::size_t window, unsigned int polynomial_order,
+                       double process_noise, double measurement_noise,
+                       std::size_t history) {
+             auto estimator = std::make_shared<JointStateEstimator>(
+                 method, window, polynomial_order, process_noise,
+                 measurement_noise, history);
+             client.set_state_estimator(estimator);
+             return estimator;
+           }),
+           py::arg("client"),
+           py::arg("method") = EstimationMethod::FINITE_DIFFERENCE,
+           py::arg("window") = 7, py::arg("polynomial_order") = 2,
+           py::arg("process_noise") = 1e4, py::arg("measurement_noise") = 1e-10,
+           py::arg("history") = 3)
+      .def_property_readonly("method", &JointStateEstimator::method)
+      .def_property_readonly("window", &JointStateEstimator::window)
+      .def_property_readonly("polynomial_order",
+                             &JointStateEstimator::polynomial_order)
+      .def_property_readonly("history", &JointStateEstimator::history)
+      .def_property_readonly("count", &JointStateEstimator::count)
+      .def("reset", &JointStateEstimator::reset)
+      .def("q",
+           [](const JointStateEstimator &self, long idx) {
+             return fromJointArray(self.position(idx));
+           })
+      .def("dq",
+           [](const JointStateEstimator &self, long idx) {
+             return fromJointArray(self.velocity(idx));
+           })
+      .def("ddq",
+           [](const JointStateEstimator &self, long idx) {
+             return fromJointArray(self.acceleration(idx));
+           })
+      .def("get_position",
+           [](py::object self) {
+             const JointStateEstimator &estimator =
+                 self.cast<const JointStateEstimator &>();
+             return stateView<JointStateEstimator::N>(
+                 estimator.position(-1).data(), self);
+           })
+      .def(
+          "get_position",
+          [](const JointStateEstimator &self, py::array out) {
+            return stateCopy<JointStateEstimator::N>(self.position(-1).data(),
+                                                     out);
+          },
+          py::arg("out"))
+      .def("get_velocity",
+           [](py::object self) {
+             const JointStateEstimator &estimator =
+                 self.cast<const JointStateEstimator &>();
+             return stateView<JointStateEstimator::N>(
+                 estimator.velocity(-1).data(), self);
+           })
+      .def(
+          "get_velocity",
+          [](const JointStateEstimator &self, py::array out) {
+            return stateCopy<JointStateEstimator::N>(self.velocity(-1).data(),
+                                                     out);
+          },
+          py::arg("out"))
+      .def("get_acceleration",
+           [](py::object self) {
+             const JointStateEstimator &estimator =
+                 self.cast<const JointStateEstimator &>();
+             return stateView<JointStateEstimator::N>(
+                 estimator.acceleration(-1).data(), self);
+           })
+      .def(
+          "get_acceleration",
+          [](const JointStateEstimator &self, py::array out) {
+            return stateCopy<JointStateEstimator::N>(
+                self.acceleration(-1).data(), out);
+          },
+          py::arg("out"));
+
+  py::enum_<RecordingFormat>(m, "RecordingFormat")
+      .value("CSV", RecordingFormat::CSV)
+      .value("BINARY", RecordingFormat::BINARY)
+      .value("COLUMNAR", RecordingFormat::COLUMNAR)
+      .export_values();
+
+  py::enum_<DeadlineFallback>(m, "DeadlineFallback")
+      .value("HOLD_LAST", DeadlineFallback::HOLD_LAST)
+      .value("IPO_POSITION", DeadlineFallback::IPO_POSITION)
+      .export_values();
+
+  py::enum_<TelemetryProtocol>(m, "TelemetryProtocol")
+      .value("UDP", TelemetryProtocol::UDP)
+      .value("TCP", TelemetryProtocol::TCP)
+      .export_values();
+
+  m.def("convert_recording_to_csv", &convertRecordingToCsv,
+        py::arg("binary_file_name"), py::arg("csv_file_name"),
+        "Convert a binary or columnar recording written by "
+        "ClientApplication.collect_data to CSV.");
+
+  py::class_<KUKA::FRI::IConnection, std::shared_ptr<KUKA::FRI::IConnection>>(
+      m, "Connection",
+      "Transport between ClientApplication and the controller.")
+      .def("isOpen", &KUKA::FRI::IConnection::isOpen);
+
+  py::class_<KUKA::FRI::UdpConnection, KUKA::FRI::IConnection,
+             std::shared_ptr<KUKA::FRI::UdpConnection>>(m, "UdpConnection")
+      .def(py::init<unsigned int>(), py::arg("receive_timeout") = 0);
+
+  py::class_<PollableConnection, KUKA::FRI::IConnection,
+             std::shared_ptr<PollableConnection>>(m, "PollableConnection")
+      .def("fileno", &PollableConnection::fileno)
+      .def(
+          "wait",
+          [](const PollableConnection &self, int timeout_ms) {
+            py::gil_scoped_release release;
+            return self.wait(timeout_ms);
+          },
+          py::arg("timeout_ms") = -1);
+
+  py::class_<SocketConnection, PollableConnection,
+             std::shared_ptr<SocketConnection>>(
+      m, "SocketConnection",
+      "UdpConnection with a pollable socket, the default connection.")
+      .def(py::init<unsigned int>(), py::arg("receive_timeout") = 0);
+
+  py::class_<RecordingConnection, PollableConnection,
+             std::shared_ptr<RecordingConnection>>(
+      m, "RecordingConnection",
+      "SocketConnection that records the received packets for a "
+      "ReplayConnection.")
+      .def(py::init<const std::string &, unsigned int>(), py::arg("file_name"),
+           py::arg("receive_timeout") = 0)
+      .def_property_readonly("file_name", &RecordingConnection::file_name)
+      .def("recorded_packets", &RecordingConnection::recorded_packets)
+      .def("dropped_packets", &RecordingConnection::dropped_packets);
+
+  py::class_<ReplayConnection, KUKA::FRI::IConnection,
+             std::shared_ptr<ReplayConnection>>(
+      m, "ReplayConnection",
+      "Replays the packets of a RecordingConnection as fast as possible, "
+      "commands are discarded.")
+      .def(py::init<const std::string &>(), py::arg("file_name"))
+      .def("packets", &ReplayConnection::packets)
+      .def("received", &ReplayConnection::received)
+      .def("sent", &ReplayConnection::sent);
+
+  py::class_<PacketTimestamps>(
+      m, "PacketTimestamps",
+      "Host times (ns since the epoch) of the last packet exchange with the "
+      "controller, 0 if unknown. The receive time is taken by the kernel on "
+      "arrival if `kernel` is true.")
+      .def_readonly("receive", &PacketTimestamps::receive)
+      .def_readonly("send", &PacketTimestamps::send)
+      .def_readonly("kernel", &PacketTimestamps::kernel);
 
   py::class_<PyClientApplication>(m, "ClientApplication")
-      .def(py::init<PyLBRClient &>())
+      .def(py::init<PyLBRClient &, std::shared_ptr<KUKA::FRI::IConnection>>(),
+           py::arg("client"), py::arg("connection") = nullptr,
+           py::keep_alive<1, 2>())
       .def("connect", &PyClientApplication::connect)
-      .def("collect_data", &PyClientApplication::collect_data)
+      .def("reconnect", &PyClientApplication::reconnect,
+           py::arg("timeout_ms") = -1, py::arg("reset_estimator") = false,
+           "Wait for the next session after IDLE, returns False on timeout. "
+           "The connection, recording, telemetry, client, controller and "
+           "estimator are kept, so step() resumes with the first packet. The "
+           "estimator state stays warm unless reset_estimator is True.")
+      .def("collect_data", &PyClientApplication::collect_data,
+           py::arg("file_name"), py::arg("format") = RecordingFormat::CSV,
+           py::arg("signals") = defaultRecordSignals(),
+           py::arg("decimation") = 1,
+           "Record the given signals of every decimation-th step. Joint "
+           "signals are 'mp', 'ip', 'mt', 'et' and 'ct' (plus 'cp' on FRI 1), "
+           "FRI 2 adds 'pose' and 'redundancy'. 'dt' and 'tp' record the "
+           "sample time and tracking performance, and 'analog:<name>', "
+           "'digital:<name>' and 'boolean:<name>' the IO values. An unknown "
+           "IO raises a ValueError, here once a state was received, otherwise "
+           "from the step() that records the first sample.")
       .def("disconnect", &PyClientApplication::disconnect)
-      .def("step", &PyClientApplication::step);
+      .def("step", &PyClientApplication::step, py::arg("timeout_ms") = -1,
+           "Run one cycle, returns False if it failed. With timeout_ms >= 0 "
+           "StepTimeout (a TimeoutError) is raised if no packet arrives in "
+           "time.")
+      .def("wait", &PyClientApplication::wait, py::arg("timeout_ms") = -1,
+           "Wait until step() would not block, returns False on timeout.")
+      .def("fileno", &PyClientApplication::fileno)
+      .def("start_background", &PyClientApplication::start_background,
+           py::arg("priority") = 0, py::arg("cpu") = -1,
+           py::arg("across_sessions") = false,
+           py::arg("reset_estimator") = false,
+           "Run the FRI cycle on a dedicated thread. priority > 0 selects "
+           "SCHED_FIFO, cpu >= 0 pins the thread to that CPU. With "
+           "across_sessions the loop continues with the next session after "
+           "IDLE, the estimator state stays warm unless reset_estimator is "
+           "True.")
+      .def("stop_background", &PyClientApplication::stop_background)
+      .def("is_running", &PyClientApplication::is_running)
+      .def(
+          "latest_state",
+          [](PyClientApplication &self, py::array out) {
+            char *record =
+                snapshotRecord(out, py::dtype::of<LBRStateSnapshot>());
+            return self.latest_state(
+                *reinterpret_cast<LBRStateSnapshot *>(record));
+          },
+          py::arg("out"),
+          "Fill out (dtype STATE_SNAPSHOT_DTYPE) with the latest state, "
+          "returns whether it changed since the previous call.")
+      .def(
+          "cycle_statistics",
+          [](PyClientApplication &self) {
+            const CycleStatistics &statistics = self.cycle_statistics();
+            py::dict result;
+            result["deadline_misses"] = statistics.deadline_misses();
+            result["fallback_commands"] = self.fallback_commands();
+            result["period_overruns"] = statistics.period_overruns();
+            const std::pair<const char *, const Histogram *> histograms[] = {
+                {"receive", &statistics.receive},
+                {"callback", &statistics.callback},
+                {"send", &statistics.send},
+                {"period", &statistics.period},
+                {"turnaround", &statistics.turnaround}};
+            for (const auto &histogram : histograms) {
+              const Histogram::Summary summary = histogram.second->summary();
+              py::dict entry;
+              entry["count"] = summary.count;
+              entry["mean"] = summary.mean;
+              entry["p50"] = summary.p50;
+              entry["p99"] = summary.p99;
+              entry["max"] = summary.max;
+              result[histogram.first] = entry;
+            }
+            return result;
+          },
+          "Timing of the FRI cycles (in microseconds) since the last reset, "
+          "can be called while the background loop is running.")
+      .def(
+          "packet_timestamps",
+          [](const PyClientApplication &self) {
+            if (self.is_running())
+              throw std::runtime_error("packet_timestamps() cannot be called "
+                                       "while the background loop is "
+                                       "running.");
+            return self.packet_timestamps();
+          },
+          "Host times of the last received packet and sent reply.")
+      .def(
+          "reset_cycle_statistics",
+          [](PyClientApplication &self) { self.cycle_statistics().reset(); },
+          "Clear the cycle statistics, takes effect with the next cycle.")
+      .def("set_command_deadline", &PyClientApplication::set_command_deadline,
+           py::arg("budget_us"),
+           py::arg("fallback") = DeadlineFallback::HOLD_LAST,
+           "Run the Python waitForCommand and command with a budget of "
+           "budget_us per cycle. A late callback is cut off (its further "
+           "commands raise CommandDeadlineExceeded) and the fallback is sent "
+           "instead, counted as fallback_commands in cycle_statistics(). In "
+           "the CARTESIAN_POSE client command mode the fallback is the last "
+           "or the interpolated Cartesian pose. "
+           "budget_us <= 0 removes the deadline.")
+      .def("publish_state", &PyClientApplication::publish_state,
+           py::arg("name"), py::arg("slots") = 1024,
+           "Publish the state of every cycle to the shared-memory segment "
+           "/name, a ring of the last `slots` samples.")
+      .def("stop_publishing", &PyClientApplication::stop_publishing)
+      .def("export_telemetry", &PyClientApplication::export_telemetry,
+           py::arg("host"), py::arg("port"),
+           py::arg("protocol") = TelemetryProtocol::UDP,
+           py::arg("signals") = defaultRecordSignals(),
+           py::arg("decimation") = 1, py::arg("batch_size") = 20,
+           "Stream the signals of every decimation-th step (names as in "
+           "collect_data) to host:port in batches of batch_size samples, "
+           "read them with pyfri.tools.telemetry. Samples are sent from a "
+           "background thread in every session state, signals that are only "
+           "sent while commanding, e.g. 'ip', are NaN in the others.")
+      .def("stop_telemetry", &PyClientApplication::stop_telemetry)
+      .def(
+          "telemetry_statistics",
+          [](const PyClientApplication &self) {
+            const TelemetryWriter *writer = self.telemetry_writer();
+            py::dict result;
+            result["exporting"] = writer != nullptr;
+            result["sent_batches"] = writer ? writer->sent_batches() : 0;
+            result["failed_batches"] = writer ? writer->failed_batches() : 0;
+            result["dropped_samples"] = self.telemetry_dropped_samples();
+            return result;
+          },
+          "Batches sent and lost to failed sends, and samples dropped "
+          "because the sender could not keep up, since export_telemetry().");
+
+  py::class_<MultiClientApplication>(m, "MultiClientApplication")
+      .def(py::init<std::vector<PyClientApplication *>, bool>(),
+           py::arg("apps"), py::arg("release_gil") = true,
+           py::keep_alive<1, 2>())
+      .def("__len__", &MultiClientApplication::size)
+      .def("step", &MultiClientApplication::step, py::arg("timeout_ms") = -1,
+           "Wait for packets and step every robot that received one. Returns "
+           "False if the step of any robot failed.")
+      .def("stepped", &MultiClientApplication::stepped,
+           "Indices of the robots stepped by the last step().");
+
+  py::class_<SharedStateReader>(m, "SharedStateReader")
+      .def(py::init<const std::string &>(), py::arg("name"))
+      .def_property_readonly("name", &SharedStateReader::name)
+      .def_property_readonly("slot_count", &SharedStateReader::slot_count)
+      .def_property_readonly("published", &SharedStateReader::published,
+                             "Number of samples published so far.")
+      .def(
+          "latest",
+          [](const SharedStateReader &self, py::array out) {
+            char *record =
+                snapshotRecord(out, py::dtype::of<LBRStateSnapshot>());
+            return self.latest(*reinterpret_cast<LBRStateSnapshot *>(record));
+          },
+          py::arg("out"),
+          "Fill out (dtype STATE_SNAPSHOT_DTYPE) with the most recent sample, "
+          "returns its index or -1 if nothing was published yet.")
+      .def(
+          "read",
+          [](const SharedStateReader &self, std::uint64_t index,
+             py::array out) {
+            char *record =
+                snapshotRecord(out, py::dtype::of<LBRStateSnapshot>());
+            return self.read(index,
+                             *reinterpret_cast<LBRStateSnapshot *>(record));
+          },
+          py::arg("index"), py::arg("out"),
+          "Fill out with sample `index`, returns False if it is not in the "
+          "ring (anymore).")
+      .def(
+          "history",
+          [](const SharedStateReader &self, py::array out) {
+            char *records =
+                snapshotRecord(out, py::dtype::of<LBRStateSnapshot>());
+            if (out.ndim() != 1 || !(out.flags() & py::array::c_style)) {
+              throw std::runtime_error(
+                  "Output array must be one-dimensional and contiguous!");
+            }
+            std::uint64_t first = 0;
+            const std::size_t count = self.history(
+                static_cast<std::size_t>(out.shape(0)),
+                reinterpret_cast<LBRStateSnapshot *>(records), first);
+            return py::make_tuple(first, count);
+          },
+          py::arg("out"),
+          "Fill out[:count] with the most recent samples, oldest first, and "
+          "return (index of the first sample, count).");
 }
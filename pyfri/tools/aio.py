@@ -0,0 +1,75 @@
+import asyncio
+
+from pyfri import ClientApplication, StepTimeout
+
+
+class AsyncClientApplication(ClientApplication):
+    """
+
+    AsyncClientApplication
+    ======================
+
+    ClientApplication driven by an asyncio event loop. Every FRI cycle is
+    awaited on the socket of the connection, so the loop keeps serving other
+    tasks (network I/O, supervisory coroutines) while waiting for the
+    controller, without a thread in between.
+
+        app = AsyncClientApplication(client)
+        app.connect(30200, "172.31.1.147")
+        async for state in app.cycles():
+            ...
+
+    The client callbacks still compute the command inside the cycle, the body
+    of the loop runs after the command was sent (e.g. to update the targets
+    the client uses in the next cycle). The state is valid until the next
+    iteration. A body that awaits longer than the sample time makes the
+    following cycles late.
+
+    """
+
+    def __init__(self, client, connection=None):
+        super().__init__(client, connection)
+        self._client = client
+
+    async def cycles(self, timeout=None):
+        """Step once per packet and yield the robot state.
+
+        Stops when a step fails, e.g. because the connection was lost. With a
+        timeout in seconds StepTimeout is raised if no packet arrives in time.
+        Connections without a socket (ReplayConnection, UdpConnection on
+        Windows) are stepped on the default executor.
+        """
+        loop = asyncio.get_running_loop()
+        while True:
+            try:
+                fd = self.fileno()  # changes with every connect()
+            except RuntimeError:
+                fd = None
+
+            if fd is None:
+                timeout_ms = -1 if timeout is None else int(timeout * 1000)
+                stepped = await loop.run_in_executor(None, self.step, timeout_ms)
+            else:
+                await self._readable(loop, fd, timeout)
+                stepped = self.step(0)
+
+            if not stepped:
+                return
+            yield self._client.robotState()
+
+    @staticmethod
+    async def _readable(loop, fd, timeout):
+        readable = loop.create_future()
+
+        def ready():
+            # The reader may fire again before the awaiting task resumes
+            if not readable.done():
+                readable.set_result(None)
+
+        loop.add_reader(fd, ready)
+        try:
+            await asyncio.wait_for(readable, timeout)
+        except asyncio.TimeoutError:
+            raise StepTimeout(f"No packet arrived within {timeout} s.") from None
+        finally:
+            loop.remove_reader(fd)
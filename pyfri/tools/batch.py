@@ -0,0 +1,250 @@
+import os
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+from numpy.lib.stride_tricks import sliding_window_view
+from pyfri import Kinematics, pinv
+
+from .state_estimators import WrenchEstimator, _check_native_kinematics
+
+#
+# Batch versions of the online estimators and filters for recorded sessions.
+#
+# Every row of the input arrays is one control cycle, in the order in which
+# the online class would have seen it. The results are bit-identical to those
+# of the online classes: the elementwise steps and reductions are the same
+# numpy operations on arrays of the same layout, numpy's matmul evaluates
+# every product of a stack with the BLAS routine of the single product, and
+# the Jacobians and pseudo-inverses come from the same compiled kernels. Those
+# release the GIL, so that blocks of rows run in parallel on `threads`
+# threads, 0 for one per core.
+#
+
+BLOCK_SIZE = 1 << 16  # Rows per block, bounds the temporaries of a thread
+
+
+def _parallel(function, count, threads):
+    # Call function(begin, end) for blocks of rows that cover range(count)
+    bounds = list(range(0, count, BLOCK_SIZE)) + [count]
+    threads = min(threads or os.cpu_count() or 1, len(bounds) - 1)
+    if threads <= 1:
+        for begin, end in zip(bounds[:-1], bounds[1:]):
+            function(begin, end)
+        return
+    with ThreadPoolExecutor(threads) as pool:
+        list(pool.map(function, bounds[:-1], bounds[1:]))
+
+
+def _sample_times(dt, count):
+    # Sample time of every row as a column, from a scalar or an (n,) array
+    dt = np.asarray(dt, dtype=np.float64)
+    if dt.ndim == 0:
+        return np.full((count, 1), dt)
+    if dt.shape != (count,):
+        raise ValueError(f"dt must be a scalar or have shape ({count},)")
+    return dt.reshape(count, 1)
+
+
+def _products(A, x):
+    # A[i] @ x[i] for every row, as matmul of a matrix and a vector
+    return np.matmul(A, x[:, :, np.newaxis])[:, :, 0]
+
+
+def _rows(function):
+    # Models without batch support are evaluated row by row
+    return lambda q: np.stack([function(qi) for qi in q])
+
+
+def _kinematics(robot_model, tip_link, base_link):
+    # Batch transform and geometric Jacobian functions, as resolved online
+    if isinstance(robot_model, Kinematics):
+        _check_native_kinematics(robot_model, tip_link, base_link)
+        return robot_model.forward_kinematics, robot_model.jacobian
+    if base_link is None:
+        T = robot_model.get_global_link_transform_function(tip_link, numpy_output=True)
+        J = robot_model.get_global_link_geometric_jacobian_function(
+            tip_link, numpy_output=True
+        )
+    elif isinstance(base_link, str):
+        T = robot_model.get_link_transform_function(
+            tip_link, base_link, numpy_output=True
+        )
+        J = robot_model.get_link_geometric_jacobian_function(
+            tip_link, base_link, numpy_output=True
+        )
+    else:
+        raise ValueError(f"{base_link=} was not recognized")
+    return _rows(T), _rows(J)
+
+
+#
+# Filters
+#
+
+
+def exponential_filter(x, smooth=0.02):
+    """ExponentialStateFilter(smooth) applied to the rows of x.
+
+    The filter is recursive, the rows are processed one by one. The native
+    ExponentialFilter.filter_batch is much faster, but rounds differently.
+    """
+    x = np.asarray(x)
+    y = np.empty(x.shape)
+    if len(x) == 0:
+        return y
+    # Rows as arrays, numpy scalars would be promoted differently
+    xp = x[:1].astype(np.float64)
+    for k in range(len(x)):
+        xp = smooth * x[k : k + 1] + (1.0 - smooth) * xp
+        y[k : k + 1] = xp
+    return y
+
+
+def moving_average(x, window_size):
+    """MovingAverageFilter(window_size) applied to the rows of x."""
+    x = np.ascontiguousarray(x, dtype=np.float64)
+    y = np.empty(x.shape)
+
+    # The windows that are not full yet
+    for k in range(min(window_size - 1, len(x))):
+        y[k] = np.mean(x[: k + 1], axis=0)
+
+    # The mean over the window axis reduces the rows in order, as the online
+    # mean over the rows of the window does
+    if len(x) >= window_size:
+        windows = sliding_window_view(x, window_size, axis=0)
+        y[window_size - 1 :] = np.mean(windows, axis=-1)
+    return y
+
+
+def filter_signal(make_filter, x, threads=0):
+    """Filter the rows of x (n, channels) with native SignalFilters.
+
+    make_filter() returns a fresh filter, e.g.
+    lambda: pyfri.ButterworthFilter(10.0, 1000.0). The channels are filtered
+    independently, so they are split over the threads, each filtering its
+    channels with its own filter. The result equals that of one filter fed
+    with the rows in order.
+    """
+    x = np.asarray(x, dtype=np.float64)
+    if x.ndim != 2:
+        raise ValueError("x must have shape (n, channels)")
+    y = np.empty(x.shape)
+    channels = x.shape[1]
+    threads = min(threads or os.cpu_count() or 1, channels)
+    if threads <= 1:
+        return make_filter().filter_batch(x, out=y)
+
+    bounds = [channels * i // threads for i in range(threads + 1)]
+
+    def run(begin, end):
+        y[:, begin:end] = make_filter().filter_batch(
+            np.ascontiguousarray(x[:, begin:end])
+        )
+
+    with ThreadPoolExecutor(threads) as pool:
+        list(pool.map(run, bounds[:-1], bounds[1:]))
+    return y
+
+
+#
+# Estimators
+#
+
+
+def joint_states(q, dt):
+    """Position, velocity and acceleration of JointStateEstimator.
+
+    q holds the measured joint positions (n, NUMBER_OF_JOINTS) and dt the
+    sample time, as a scalar or per row. The online estimator reads the
+    float32 getMeasuredJointPosition(), pass q.astype(np.float32) to
+    reproduce it from recorded float64 positions. For the native estimator
+    see pyfri.estimate_joint_states.
+    """
+    q = np.ascontiguousarray(q, dtype=np.float64)
+    dt = _sample_times(dt, len(q))
+
+    # The first sample starts at rest
+    qp = np.concatenate([q[:1], q[:-1]])
+    dq = (q - qp) / dt
+    dqp = np.concatenate([np.zeros_like(dq[:1]), dq[:-1]])
+    ddq = (dq - dqp) / dt
+    return q, dq, ddq
+
+
+def task_space_states(robot_model, q, dq, dt, ee_link, base_link=None, threads=0):
+    """Transform (n, 4, 4), velocity (n, 6) and acceleration (n, 6) of
+    TaskSpaceStateEstimator.
+
+    q and dq are the positions and velocities of the joint state estimator
+    the online estimator would use, e.g. from joint_states().
+    """
+    T, J = _kinematics(robot_model, ee_link, base_link)
+    q = np.ascontiguousarray(q, dtype=np.float64)
+    dq = np.ascontiguousarray(dq, dtype=np.float64)
+    dt = _sample_times(dt, len(q))
+    transform = np.empty((len(q), 4, 4))
+    velocity = np.empty((len(q), 6))
+
+    def run(begin, end):
+        transform[begin:end] = T(q[begin:end])
+        velocity[begin:end] = _products(J(q[begin:end]), dq[begin:end])
+
+    _parallel(run, len(q), threads)
+
+    # The previous velocity of the first sample is that of the estimator at
+    # rest
+    previous = np.empty_like(velocity)
+    previous[1:] = velocity[:-1]
+    if len(q) > 0:
+        previous[0] = J(q[:1])[0] @ np.zeros(dq.shape[1])
+    return transform, velocity, (velocity - previous) / dt
+
+
+def _wrench(robot_model, q, tau_ext, tip_link, base_link, n_data, threads, joint):
+    _, J = _kinematics(robot_model, tip_link, base_link)
+    q = np.ascontiguousarray(q, dtype=np.float64)
+    tau_ext = np.ascontiguousarray(tau_ext, dtype=np.float64)
+    rcond = WrenchEstimator._rcond
+    wrench = np.full((len(q), 6), np.nan)
+    if len(q) <= n_data:
+        return wrench
+
+    # Collected as update() does until ready()
+    tau_data = np.array(tau_ext[:n_data])
+    if joint:
+        offset = tau_data.mean(axis=0)
+    else:
+        Jinv = pinv(J(q[:n_data]), rcond=rcond)
+        offset = np.einsum("nji,nj->ni", Jinv, tau_data).mean(axis=0)
+
+    def run(begin, end):
+        begin += n_data
+        end += n_data
+        JinvT = np.swapaxes(pinv(J(q[begin:end]), rcond=rcond), 1, 2)
+        if joint:
+            wrench[begin:end] = _products(JinvT, tau_ext[begin:end] - offset)
+        else:
+            wrench[begin:end] = _products(JinvT, tau_ext[begin:end]) - offset
+
+    _parallel(run, len(q) - n_data, threads)
+    return wrench
+
+
+def wrench_joint_offset(
+    robot_model, q, tau_ext, tip_link, base_link=None, n_data=50, threads=0
+):
+    """Wrench (n, 6) of WrenchEstimatorJointOffset.
+
+    q are the estimated joint positions and tau_ext the external torques
+    (n, NUMBER_OF_JOINTS), e.g. the recorded getExternalTorque(). As online,
+    the first n_data rows are collected for the offset, their rows are NaN.
+    """
+    return _wrench(robot_model, q, tau_ext, tip_link, base_link, n_data, threads, True)
+
+
+def wrench_task_offset(
+    robot_model, q, tau_ext, tip_link, base_link=None, n_data=50, threads=0
+):
+    """Wrench (n, 6) of WrenchEstimatorTaskOffset, see wrench_joint_offset()."""
+    return _wrench(robot_model, q, tau_ext, tip_link, base_link, n_data, threads, False)
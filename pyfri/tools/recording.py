@@ -0,0 +1,50 @@
+import numpy as np
+
+BINARY_MAGIC = b"PYFRIREC"
+COLUMNAR_MAGIC = b"PYFRICOL"
+NAME_SIZE = 28
+VERSION = 1
+DTYPES = {0: "<i8", 1: "<f8"}
+
+
+def _columns(data, offset, num_columns):
+    descriptors = np.dtype([("name", f"S{NAME_SIZE}"), ("type", "<u4")])
+    columns = data[offset : offset + num_columns * descriptors.itemsize]
+    return [
+        (name.decode(), np.dtype(DTYPES[int(kind)]))
+        for name, kind in columns.view(descriptors)
+    ]
+
+
+def load_recording(file_name):
+    """Memory-map a recording written by ClientApplication.collect_data.
+
+    Returns a dict that maps the column names to read-only numpy arrays backed
+    by the file, so loading takes no time regardless of the recording length.
+    The arrays of a RecordingFormat.COLUMNAR file are contiguous, those of a
+    RecordingFormat.BINARY file are strided views of the samples.
+    """
+    data = np.memmap(file_name, dtype=np.uint8, mode="r")
+    magic = data[:8].tobytes()
+    version, num_columns = (int(value) for value in data[8:16].view("<u4"))
+    if magic not in (BINARY_MAGIC, COLUMNAR_MAGIC):
+        raise ValueError(f"{file_name} is not a pyfri binary recording")
+    if version != VERSION:
+        raise ValueError(f"Unsupported recording version {version}")
+
+    if magic == COLUMNAR_MAGIC:
+        num_rows, stride, offset = (int(value) for value in data[16:40].view("<u8"))
+        columns = _columns(data, 64, num_columns)
+        recording = {}
+        for i, (name, dtype) in enumerate(columns):
+            begin = offset + 8 * i * stride
+            recording[name] = data[begin : begin + 8 * num_rows].view(dtype)
+        return recording
+
+    columns = _columns(data, 16, num_columns)
+    offset = 16 + (NAME_SIZE + 4) * num_columns
+    num_rows = (data.size - offset) // (8 * num_columns)
+    samples = data[offset : offset + 8 * num_columns * num_rows].view(
+        np.dtype(columns)
+    )
+    return {name: samples[name] for name, _ in columns}
@@ -1,6 +1,6 @@
 import abc
 import numpy as np
-from pyfri import LBRState
+from pyfri import Kinematics, LBRState, pinv
 from collections import deque
 
 
@@ -83,6 +83,14 @@ class JointStateEstimator:
         return self.ddq(-1)
 
 
+def _check_native_kinematics(kinematics, tip_link, base_link):
+    # The compiled kernels only cover the chain from the base to the tip link
+    if tip_link != kinematics.tip_link:
+        raise ValueError(f"{tip_link=} is not the tip link of {kinematics.name}.")
+    if base_link is not None and base_link != kinematics.base_link:
+        raise ValueError(f"{base_link=} is not the base link of {kinematics.name}.")
+
+
 class TaskSpaceStateEstimator:
     """
 
@@ -102,7 +110,11 @@ class TaskSpaceStateEstimator:
         self._joint_state_estimator = joint_state_estimator
 
         # Retrieve kinematics models function
-        if base_link is None:
+        if isinstance(robot_model, Kinematics):
+            _check_native_kinematics(robot_model, ee_link, base_link)
+            self._T = robot_model.forward_kinematics
+            self._J = robot_model.jacobian
+        elif base_link is None:
             self._T = robot_model.get_global_link_transform_function(
                 ee_link, numpy_output=True
             )
@@ -196,7 +208,10 @@ class WrenchEstimator(abc.ABC):
         self._external_torque_estimator = external_torque_estimator
 
         # Setup jacobian function
-        if base_link is None:
+        if isinstance(robot_model, Kinematics):
+            _check_native_kinematics(robot_model, tip_link, base_link)
+            self._jacobian = robot_model.jacobian
+        elif base_link is None:
             self._jacobian = robot_model.get_global_link_geometric_jacobian_function(
                 tip_link,
                 numpy_output=True,
@@ -212,23 +227,49 @@ class WrenchEstimator(abc.ABC):
 
         # Setup data collector
         self._n_data = n_data
-        self._data = []
+        self._n_collected = 0
+        self._offset = None
+
+        # Inverse Jacobian of the last joint position, shared by all calls
+        # within a tick
+        self._q_cached = np.full(LBRState.NUMBER_OF_JOINTS, np.nan)
+        self._Jinv_cached = None
 
     def _inverse_jacobian(self):
         q = self._joint_state_estimator.get_position()
-        return np.linalg.pinv(self._jacobian(q), rcond=self._rcond)
+        if not np.array_equal(q, self._q_cached):
+            self._Jinv_cached = pinv(self._jacobian(q), rcond=self._rcond)
+            self._q_cached[:] = q
+        return self._Jinv_cached
 
     def ready(self):
-        return len(self._data) >= self._n_data
+        return self._n_collected >= self._n_data
 
     def update(self):
-        if len(self._data) < self._n_data:
+        if self._n_collected < self._n_data:
             self._update_data()
+            self._n_collected += 1
+            if self.ready():
+                self._offset = self._compute_offset(self._n_data)
+
+    def _current_offset(self):
+        # Until ready() the offset is the mean of the samples collected so far
+        if self._offset is not None:
+            return self._offset
+        if self._n_collected == 0:
+            raise RuntimeError(
+                "The wrench estimator is not ready, call update() to collect data."
+            )
+        return self._compute_offset(self._n_collected)
 
     @abc.abstractmethod
     def _update_data(self):
         pass
 
+    @abc.abstractmethod
+    def _compute_offset(self, n):
+        pass
+
     @abc.abstractmethod
     def get_wrench(self):
         pass
@@ -246,12 +287,19 @@ class WrenchEstimatorJointOffset(WrenchEstimator):
     """
 
     def _update_data(self):
+        if self._n_collected == 0:
+            self._tau_data = np.empty((self._n_data, LBRState.NUMBER_OF_JOINTS))
         tau_ext = self._external_torque_estimator.get_external_torque()
-        self._data.append(tau_ext.tolist())
+        self._tau_data[self._n_collected] = tau_ext
+
+    def _compute_offset(self, n):
+        return self._tau_data[:n].mean(axis=0)
 
     def get_wrench(self):
-        offset = np.mean(self._data, axis=0)
-        tau_ext = self._external_torque_estimator.get_external_torque() - offset
+        tau_ext = (
+            self._external_torque_estimator.get_external_torque()
+            - self._current_offset()
+        )
         Jinv = self._inverse_jacobian()
         return Jinv.T @ tau_ext
 
@@ -268,11 +316,21 @@ class WrenchEstimatorTaskOffset(WrenchEstimator):
     """
 
     def _update_data(self):
-        tau_ext = self._external_torque_estimator.get_external_torque()
-        f_ext = self._inverse_jacobian().T @ tau_ext
-        self._data.append(f_ext.flatten().tolist())
+        # Only the samples are kept here, they are projected all at once
+        if self._n_collected == 0:
+            self._tau_data = np.empty((self._n_data, LBRState.NUMBER_OF_JOINTS))
+            self._J_data = np.empty((self._n_data, 6, LBRState.NUMBER_OF_JOINTS))
+        q = self._joint_state_estimator.get_position()
+        self._tau_data[self._n_collected] = (
+            self._external_torque_estimator.get_external_torque()
+        )
+        self._J_data[self._n_collected] = self._jacobian(q)
+
+    def _compute_offset(self, n):
+        Jinv = pinv(self._J_data[:n], rcond=self._rcond)
+        f_ext = np.einsum("nji,nj->ni", Jinv, self._tau_data[:n])
+        return f_ext.mean(axis=0)
 
     def get_wrench(self):
-        offset = np.mean(self._data, axis=0)
         tau_ext = self._external_torque_estimator.get_external_torque()
-        return self._inverse_jacobian().T @ tau_ext - offset
+        return self._inverse_jacobian().T @ tau_ext - self._current_offset()
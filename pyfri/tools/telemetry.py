@@ -0,0 +1,119 @@
+import socket
+import struct
+
+import numpy as np
+from pyfri import TelemetryProtocol
+
+from .recording import NAME_SIZE, VERSION, _columns
+
+SCHEMA_MAGIC = b"PYFRISCH"
+BATCH_MAGIC = b"PYFRITLM"
+BATCH_HEADER_SIZE = 32
+MAX_DATAGRAM_SIZE = 65507
+
+
+def parse_schema(message):
+    """Return the numpy dtype of a sample described by a schema message."""
+    data = np.frombuffer(message, dtype=np.uint8)
+    version, num_columns = (int(value) for value in data[8:16].view("<u4"))
+    if data[:8].tobytes() != SCHEMA_MAGIC:
+        raise ValueError("Not a pyfri telemetry schema")
+    if version != VERSION:
+        raise ValueError(f"Unsupported telemetry version {version}")
+    if data.size < 16 + (NAME_SIZE + 4) * num_columns:
+        raise ValueError("Truncated telemetry schema")
+    return np.dtype(_columns(data, 16, num_columns))
+
+
+def parse_batch(message, dtype):
+    """Return the sequence number and the samples of a batch message.
+
+    The samples are a structured array of dtype, index it by column name.
+    """
+    if message[:8] != BATCH_MAGIC:
+        raise ValueError("Not a pyfri telemetry batch")
+    version, num_columns, sequence, num_rows = struct.unpack_from("<IIQI", message, 8)
+    if version != VERSION:
+        raise ValueError(f"Unsupported telemetry version {version}")
+    if num_columns != len(dtype.names):
+        raise ValueError("Telemetry batch does not match the schema")
+    samples = np.frombuffer(
+        message, dtype=dtype, count=num_rows, offset=BATCH_HEADER_SIZE
+    )
+    return sequence, samples
+
+
+class TelemetryReceiver:
+    """Receive the batches of ClientApplication.export_telemetry.
+
+    Binds (UDP) or listens on (TCP) host:port. receive() returns the sequence
+    number and samples of the next batch, or None if nothing arrived within
+    timeout seconds. Batches that arrive before the first schema message are
+    skipped, lost_batches counts the gaps in the sequence numbers.
+    """
+
+    def __init__(self, port, host="", protocol=TelemetryProtocol.UDP, timeout=None):
+        self.protocol = protocol
+        self.timeout = timeout
+        self.dtype = None
+        self.lost_batches = 0
+        self._next = None
+        self._stream = None
+        kind = (
+            socket.SOCK_DGRAM
+            if protocol == TelemetryProtocol.UDP
+            else socket.SOCK_STREAM
+        )
+        self._socket = socket.socket(socket.AF_INET, kind)
+        self._socket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self._socket.bind((host, port))
+        if protocol == TelemetryProtocol.TCP:
+            self._socket.listen(1)
+        self._socket.settimeout(timeout)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        if self._stream is not None:
+            self._stream.close()
+            self._stream = None
+        self._socket.close()
+
+    def receive(self):
+        while True:
+            message = self._message()
+            if message is None:
+                return None
+            if message[:8] == SCHEMA_MAGIC:
+                self.dtype = parse_schema(message)
+            elif self.dtype is not None:
+                sequence, samples = parse_batch(message, self.dtype)
+                if self._next is not None and sequence > self._next:
+                    self.lost_batches += sequence - self._next
+                self._next = sequence + 1
+                return sequence, samples
+
+    def _message(self):
+        try:
+            if self.protocol == TelemetryProtocol.UDP:
+                return self._socket.recv(MAX_DATAGRAM_SIZE)
+            if self._stream is None:
+                self._stream, _ = self._socket.accept()
+                self._stream.settimeout(self.timeout)
+            (size,) = struct.unpack("<I", self._read(4))
+            return self._read(size)
+        except socket.timeout:
+            return None
+
+    def _read(self, size):
+        data = bytearray()
+        while len(data) < size:
+            chunk = self._stream.recv(size - len(data))
+            if not chunk:
+                raise ConnectionError("Telemetry stream closed")
+            data += chunk
+        return bytes(data)